@@ -0,0 +1,143 @@
+#include "Session.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+extern "C" {
+  #include <X11/Xutil.h>
+}
+
+namespace {
+
+const uint32_t SESSION_MAGIC = 0x53574e49;  // "INWS"
+const uint32_t SESSION_VERSION = 1;
+
+uint64_t HashBytes(uint64_t hash, const char* data) {
+  // FNV-1a, including the terminating zero as a field separator
+  do {
+    hash ^= (unsigned char)*data;
+    hash *= 0x100000001b3ULL;
+  } while (*data++);
+  return hash;
+}
+
+void MakeDirs(const std::string& path) {
+  for (size_t pos = 1; (pos = path.find('/', pos)) != std::string::npos; pos++) {
+    mkdir(path.substr(0, pos).c_str(), 0700);
+  }
+}
+
+}
+
+SessionStore::SessionStore()
+: m_header(nullptr),
+  m_entries(nullptr),
+  m_mapSize(0) {}
+
+SessionStore::~SessionStore() {
+  if (m_header) {
+    munmap(m_header, m_mapSize);
+  }
+}
+
+bool SessionStore::Open(const std::string& path) {
+  MakeDirs(path);
+
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    perror("open session store");
+    return false;
+  }
+
+  m_mapSize = sizeof(Header) + CAPACITY * sizeof(SessionEntry);
+
+  struct stat st;
+  bool fresh = fstat(fd, &st) != 0 || (size_t)st.st_size != m_mapSize;
+  if (fresh && ftruncate(fd, m_mapSize) != 0) {
+    perror("ftruncate session store");
+    close(fd);
+    return false;
+  }
+
+  void* map = mmap(nullptr, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror("mmap session store");
+    return false;
+  }
+
+  m_header = static_cast<Header*>(map);
+  m_entries = reinterpret_cast<SessionEntry*>(m_header + 1);
+
+  if (fresh || m_header->m_magic != SESSION_MAGIC ||
+      m_header->m_version != SESSION_VERSION || m_header->m_capacity != CAPACITY) {
+    memset(map, 0, m_mapSize);
+    m_header->m_magic = SESSION_MAGIC;
+    m_header->m_version = SESSION_VERSION;
+    m_header->m_capacity = CAPACITY;
+  }
+
+  return true;
+}
+
+std::string SessionStore::DefaultPath() {
+  if (const char* state = getenv("XDG_STATE_HOME")) {
+    return std::string(state) + "/inwm/session";
+  }
+  const char* home = getenv("HOME");
+  return std::string(home ? home : "/tmp") + "/.local/state/inwm/session";
+}
+
+uint64_t SessionStore::KeyFor(Display* dpy, Window w) {
+  XClassHint hint = {};
+  if (!XGetClassHint(dpy, w, &hint)) {
+    return 0;
+  }
+
+  uint64_t key = 0xcbf29ce484222325ULL;
+  key = HashBytes(key, hint.res_name ? hint.res_name : "");
+  key = HashBytes(key, hint.res_class ? hint.res_class : "");
+  if (hint.res_name) XFree(hint.res_name);
+  if (hint.res_class) XFree(hint.res_class);
+
+  XTextProperty role;
+  Atom roleAtom = XInternAtom(dpy, "WM_WINDOW_ROLE", False);
+  if (XGetTextProperty(dpy, w, &role, roleAtom)) {
+    if (role.value) {
+      key = HashBytes(key, (const char*)role.value);
+      XFree(role.value);
+    }
+  }
+
+  return key ? key : 1;
+}
+
+const SessionEntry* SessionStore::Lookup(uint64_t key) const {
+  if (!m_entries || key == 0) return nullptr;
+
+  for (uint32_t i = 0; i < CAPACITY; i++) {
+    const SessionEntry& entry = m_entries[(key + i) % CAPACITY];
+    if (entry.m_key == key) return &entry;
+    if (entry.m_key == 0) return nullptr;
+  }
+  return nullptr;
+}
+
+void SessionStore::Update(const SessionEntry& entry) {
+  if (!m_entries || entry.m_key == 0) return;
+
+  // Linear probing, when the table is full the home slot is recycled
+  uint32_t slot = entry.m_key % CAPACITY;
+  for (uint32_t i = 0; i < CAPACITY; i++) {
+    uint32_t probe = (entry.m_key + i) % CAPACITY;
+    if (m_entries[probe].m_key == entry.m_key || m_entries[probe].m_key == 0) {
+      slot = probe;
+      break;
+    }
+  }
+
+  m_entries[slot] = entry;
+}
@@ -0,0 +1,66 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+extern "C" {
+  #include <X11/Xlib.h>
+}
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Saved placement of one kind of window, identified by WM_CLASS plus
+ * WM_WINDOW_ROLE. Geometry is that of the frame.
+ */
+struct SessionEntry {
+  uint64_t m_key;  // 0 marks a free slot
+  int32_t m_x, m_y, m_width, m_height;
+  int32_t m_snapState;
+  int32_t m_posBeforeSnap[2];
+  int32_t m_sizeBeforeSnap[2];
+};
+
+/*
+ * Window layout that survives logout. The store is a small fixed-size hash
+ * table in a memory-mapped file, so lookups never touch the disk and an
+ * update only dirties the page holding that entry.
+ */
+class SessionStore {
+  public:
+    SessionStore();
+    ~SessionStore();
+
+    /*
+     * Map the store at `path`, creating or resetting it as needed.
+     */
+    bool Open(const std::string& path);
+
+    /*
+     * $XDG_STATE_HOME/inwm/session, or ~/.local/state/inwm/session.
+     */
+    static std::string DefaultPath();
+
+    /*
+     * Hash of the window's WM_CLASS and WM_WINDOW_ROLE, 0 if it has no class.
+     */
+    static uint64_t KeyFor(Display* dpy, Window w);
+
+    const SessionEntry* Lookup(uint64_t key) const;
+    void Update(const SessionEntry& entry);
+
+  private:
+    struct Header {
+      uint32_t m_magic;
+      uint32_t m_version;
+      uint32_t m_capacity;
+      uint32_t m_reserved;
+    };
+
+    static const uint32_t CAPACITY = 512;
+
+    Header* m_header;
+    SessionEntry* m_entries;
+    size_t m_mapSize;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef SLOTMAP_HPP
+#define SLOTMAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+ * Stable reference to an element of a SlotMap. Once the element is erased
+ * the handle stops resolving, even after its slot has been reused.
+ */
+struct SlotHandle {
+  uint32_t m_index = UINT32_MAX;
+  uint32_t m_generation = 0;
+
+  bool IsNull() const { return m_index == UINT32_MAX; }
+  bool operator==(const SlotHandle& o) const {
+    return m_index == o.m_index && m_generation == o.m_generation;
+  }
+  bool operator!=(const SlotHandle& o) const { return !(*this == o); }
+};
+
+/*
+ * Generational slot map. Values live in one dense array, so iterating all of
+ * them is a linear walk over contiguous memory, and handles go through a
+ * separate slot table so they stay valid while values move around on erase.
+ */
+template <typename T>
+class SlotMap {
+  public:
+    SlotHandle Insert(T value) {
+      uint32_t index;
+      if (m_freeHead != UINT32_MAX) {
+        index = m_freeHead;
+        m_freeHead = m_slots[index].m_dense;
+      } else {
+        index = m_slots.size();
+        m_slots.push_back({ 0, 0 });
+      }
+
+      m_slots[index].m_dense = m_values.size();
+      m_values.push_back(std::move(value));
+      m_denseToSlot.push_back(index);
+
+      return { index, m_slots[index].m_generation };
+    }
+
+    T* Get(SlotHandle handle) {
+      if (!Valid(handle)) return nullptr;
+      return &m_values[m_slots[handle.m_index].m_dense];
+    }
+
+    const T* Get(SlotHandle handle) const {
+      if (!Valid(handle)) return nullptr;
+      return &m_values[m_slots[handle.m_index].m_dense];
+    }
+
+    bool Erase(SlotHandle handle) {
+      if (!Valid(handle)) return false;
+
+      Slot& slot = m_slots[handle.m_index];
+      uint32_t dense = slot.m_dense;
+      uint32_t last = m_values.size() - 1;
+
+      // Keep the values packed by moving the last one into the hole
+      if (dense != last) {
+        m_values[dense] = std::move(m_values[last]);
+        m_denseToSlot[dense] = m_denseToSlot[last];
+        m_slots[m_denseToSlot[dense]].m_dense = dense;
+      }
+      m_values.pop_back();
+      m_denseToSlot.pop_back();
+
+      slot.m_generation++;
+      slot.m_dense = m_freeHead;
+      m_freeHead = handle.m_index;
+      return true;
+    }
+
+    /*
+     * Dense access, valid until the next Insert or Erase.
+     */
+    size_t Size() const { return m_values.size(); }
+    T& At(size_t dense) { return m_values[dense]; }
+    SlotHandle HandleAt(size_t dense) const {
+      uint32_t index = m_denseToSlot[dense];
+      return { index, m_slots[index].m_generation };
+    }
+
+    typename std::vector<T>::iterator begin() { return m_values.begin(); }
+    typename std::vector<T>::iterator end() { return m_values.end(); }
+    typename std::vector<T>::const_iterator begin() const { return m_values.begin(); }
+    typename std::vector<T>::const_iterator end() const { return m_values.end(); }
+
+  private:
+    struct Slot {
+      uint32_t m_dense;       // Index into m_values, or next free slot
+      uint32_t m_generation;  // Bumped on every erase
+    };
+
+    bool Valid(SlotHandle handle) const {
+      return handle.m_index < m_slots.size() &&
+             m_slots[handle.m_index].m_generation == handle.m_generation;
+    }
+
+    std::vector<T> m_values;
+    std::vector<uint32_t> m_denseToSlot;
+    std::vector<Slot> m_slots;
+    uint32_t m_freeHead = UINT32_MAX;
+};
+
+#endif
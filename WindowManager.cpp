@@ -1,8 +1,20 @@
 #include "WindowManager.hpp"
+#include "lib/Font.hpp"
+#include "lib/GCCache.hpp"
+#include "lib/WorkerPool.hpp"
 #include <X11/X.h>
 #include <X11/Xlib.h>
+#include <X11/Xatom.h>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
 #include <algorithm>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
 extern "C" {
   #include <X11/keysym.h>
   #include <X11/fonts/font.h>
@@ -10,16 +22,22 @@ extern "C" {
 using std::unique_ptr;
 
 bool WindowManager::m_wmDetected;
-Client WindowManager::s_dragWin;
-Client WindowManager::s_resizeWin;
 int WindowManager::m_mouseX;
 int WindowManager::m_mouseY;
 
+/*
+ * Snap states come back from the session file or a previous process; treat
+ * anything we don't know as not snapped.
+ */
+static bool IsSnapState(int32_t value) {
+  return value >= NONE && value <= MAXIMIZED;
+}
+
 /*
  * Factory method for establishing a connection to an X server and creating
  * a Window Manager instance.
  */
-std::unique_ptr<WindowManager> WindowManager::Create() {
+std::unique_ptr<WindowManager> WindowManager::Create(char** argv) {
   /* Open the X display. */
   Display* dpy = XOpenDisplay(nullptr);
   if (dpy == nullptr) {
@@ -27,16 +45,24 @@ std::unique_ptr<WindowManager> WindowManager::Create() {
     return nullptr;
   }
 
-  return std::unique_ptr<WindowManager> (new WindowManager(dpy));
+  return std::unique_ptr<WindowManager> (new WindowManager(dpy, argv));
 }
 
 /*
  * Invoke internally by Create()
  */
-WindowManager::WindowManager(Display* dpy)
+WindowManager::WindowManager(Display* dpy, char** argv)
 : m_dpy (dpy),
   m_root(DefaultRootWindow(m_dpy)),
-  m_isResizing(false) {
+  m_argv(argv),
+  m_activeWindow(None) {
+  
+  m_restartAtom = XInternAtom(m_dpy, "_INWM_RESTART", False);
+  m_netSupported = XInternAtom(m_dpy, "_NET_SUPPORTED", False);
+  m_netClientList = XInternAtom(m_dpy, "_NET_CLIENT_LIST", False);
+  m_netActiveWindow = XInternAtom(m_dpy, "_NET_ACTIVE_WINDOW", False);
+  m_netWmName = XInternAtom(m_dpy, "_NET_WM_NAME", False);
+  m_utf8String = XInternAtom(m_dpy, "UTF8_STRING", False);
   
   // Get screen dimensions
   Screen* screen = DefaultScreenOfDisplay(m_dpy);
@@ -48,26 +74,63 @@ WindowManager::WindowManager(Display* dpy)
  * Disconnect from the X server.
  */
 WindowManager::~WindowManager() {
+  InWM::GCCache::release(m_dpy);
+  InWM::Font::release(m_dpy);
   XCloseDisplay(m_dpy);
 }
 
 void WindowManager::Run() {
   /* Initialization */
-  m_wmDetected = false;
-  
-  XSetErrorHandler(&WindowManager::OnWMDetected);
-  XSelectInput(m_dpy, m_root, SubstructureRedirectMask | SubstructureNotifyMask | 
-               PointerMotionMask | ButtonPressMask | KeyPressMask);
+  const char* restartFd = getenv("INWM_RESTART_FD");
 
-  XSync(m_dpy, false);
-  if (m_wmDetected) {
-    printf("Detected another window manager %s\n", XDisplayString(m_dpy));
-    return;
+  // After a restart the server may not have reaped our previous connection
+  // yet, so keep trying to take over the root for a moment.
+  for (int attempt = 0; ; attempt++) {
+    m_wmDetected = false;
+
+    XSetErrorHandler(&WindowManager::OnWMDetected);
+    XSelectInput(m_dpy, m_root, SubstructureRedirectMask | SubstructureNotifyMask | 
+                 PointerMotionMask | ButtonPressMask | KeyPressMask);
+
+    XSync(m_dpy, false);
+    if (!m_wmDetected) break;
+
+    if (!restartFd || attempt >= 100) {
+      printf("Detected another window manager %s\n", XDisplayString(m_dpy));
+      return;
+    }
+    usleep(10000);
   }
 
   XSetErrorHandler(&WindowManager::OnXError);
+
+  m_session.Open(SessionStore::DefaultPath());
+  m_windowState.open(m_dpy);
+
+  if (restartFd) {
+    RestoreState(atoi(restartFd));
+    unsetenv("INWM_RESTART_FD");
+  }
+
+  SetupEwmh();
   
+  InWM::WorkerPool& pool = InWM::WorkerPool::shared();
+
   while (true) {
+    if (!XPending(m_dpy)) {
+      // Apply finished background work in one batch, then sleep until the
+      // server or a worker has something for us
+      pool.runCompletions();
+      if (XPending(m_dpy)) continue;
+
+      pollfd fds[2] = {
+        { ConnectionNumber(m_dpy), POLLIN, 0 },
+        { pool.completionFd(), POLLIN, 0 }
+      };
+      poll(fds, 2, -1);
+      continue;
+    }
+
     XEvent e;
     XNextEvent(m_dpy, &e);
 
@@ -108,6 +171,12 @@ void WindowManager::Run() {
       case KeyPress:
         OnKeyPressNotify(e.xkey);
         break;
+      case PropertyNotify:
+        OnPropertyNotify(e.xproperty);
+        break;
+      case ClientMessage:
+        OnClientMessage(e.xclient);
+        break;
       
       default:
         printf("Ignored event\n");
@@ -144,9 +213,16 @@ void WindowManager::OnConfigureRequest(const XConfigureRequestEvent& e) {
   changes.sibling = e.above;
   changes.stack_mode = e.detail;
 
-  if (m_clients.count(e.window)) {
-    Window frame = m_clients[e.window].m_frame;
-    XConfigureWindow(m_dpy, frame, e.value_mask, &changes);
+  if (Client* client = FindClientByWindow(e.window)) {
+    XConfigureWindow(m_dpy, client->m_frame, e.value_mask, &changes);
+
+    if (e.value_mask & CWX) client->m_position.x = e.x;
+    if (e.value_mask & CWY) client->m_position.y = e.y;
+    if (e.value_mask & CWWidth) client->m_size.x = e.width;
+    if (e.value_mask & CWHeight) client->m_size.y = e.height;
+    if (e.value_mask & (CWX | CWY | CWWidth | CWHeight)) {
+      PublishWindowState();
+    }
   }
 
   XConfigureWindow(m_dpy, e.window, e.value_mask, &changes);
@@ -154,7 +230,7 @@ void WindowManager::OnConfigureRequest(const XConfigureRequestEvent& e) {
 }
 
 void WindowManager::OnMapRequest(const XMapRequestEvent& e) {
-  Frame(e.window, "Hello, World!");
+  Frame(e.window, FetchTitle(e.window));
   XMapWindow(m_dpy, e.window);
 }
 
@@ -189,6 +265,18 @@ void WindowManager::Frame(Window w, const std::string& title) {
   XWindowAttributes xattr;
   XGetWindowAttributes(m_dpy, w, &xattr);
 
+  // Put the window back where it was last session, so it is framed at its
+  // final geometry instead of being moved after the fact
+  uint64_t sessionKey = SessionStore::KeyFor(m_dpy, w);
+  const SessionEntry* placement = m_session.Lookup(sessionKey);
+  if (placement) {
+    xattr.x = placement->m_x;
+    xattr.y = placement->m_y;
+    xattr.width = std::max(1, placement->m_width - (int)(BORDER_WIDTH * 2));
+    xattr.height = std::max(1, placement->m_height - (int)(TITLEBAR_HEIGHT + BORDER_WIDTH * 2));
+    XResizeWindow(m_dpy, w, xattr.width, xattr.height);
+  }
+
   // Calculate total window size including borders and title bar
   int totalWidth = xattr.width + (BORDER_WIDTH * 2);
   int totalHeight = xattr.height + TITLEBAR_HEIGHT + (BORDER_WIDTH * 2);
@@ -259,13 +347,6 @@ void WindowManager::Frame(Window w, const std::string& title) {
   // Set background for main content area
   XSetWindowBackground(m_dpy, innerBorder, BACKGROUND_COLOR);
 
-  // Select input masks
-  XSelectInput(m_dpy, frame, SubstructureRedirectMask | SubstructureNotifyMask);
-  XSelectInput(m_dpy, titlebar, ButtonPressMask | ButtonReleaseMask | ButtonMotionMask);
-  XSelectInput(m_dpy, closeButton, ButtonPressMask);
-  XSelectInput(m_dpy, zoomButton, ButtonPressMask);
-  XSelectInput(m_dpy, resizeHandle, ButtonPressMask | ButtonReleaseMask | ButtonMotionMask);
-
   // Map all windows
   XMapWindow(m_dpy, frame);
   XMapWindow(m_dpy, outerBorder);
@@ -289,40 +370,75 @@ void WindowManager::Frame(Window w, const std::string& title) {
   // Set up title text drawing (you'll need to handle this in expose events)
   setupTitleText(titlebar, title);
 
-  // Raise and focus
-  XRaiseWindow(m_dpy, frame);
-  XSetInputFocus(m_dpy, w, RevertToPointerRoot, CurrentTime);
-
   // Store client info
-  m_clients[w] = {
+  bool restoreSnap = placement && placement->m_snapState != NONE &&
+                     IsSnapState(placement->m_snapState);
+  SlotHandle handle = m_clients.Insert({
     // frame, w, closeButton, zoomButton, titlebar, resizeHandle, title,
     // NONE, { xattr.width, xattr.height }, { xattr.x, xattr.y }
     .m_frame = frame,
     .m_client = w,
     .m_closeButton = closeButton,
+    .m_zoomButton = zoomButton,
     .m_titlebar = titlebar,
     .m_resizeHandle = resizeHandle,
     .m_title = title,
-    .m_snapState = NONE,
-    .m_sizeBeforeSnap = { xattr.width, xattr.height },
-    .m_posBeforeSnap = { xattr.x, xattr.y }
-  };
+    .m_position = { xattr.x, xattr.y },
+    .m_size = { totalWidth, totalHeight },
+    .m_snapState = restoreSnap ? (SnapState)placement->m_snapState : NONE,
+    .m_sizeBeforeSnap = restoreSnap ?
+      Vector2D { placement->m_sizeBeforeSnap[0], placement->m_sizeBeforeSnap[1] } :
+      Vector2D { xattr.width, xattr.height },
+    .m_posBeforeSnap = restoreSnap ?
+      Vector2D { placement->m_posBeforeSnap[0], placement->m_posBeforeSnap[1] } :
+      Vector2D { xattr.x, xattr.y },
+    .m_sessionKey = sessionKey
+  });
+  m_clientIndex[w] = handle;
+  m_mapOrder.push_back(w);
+
+  SelectFrameInput(*m_clients.Get(handle));
+
+  // Raise and focus
+  ActivateClient(*m_clients.Get(handle));
+  UpdateClientList();
+}
+
+void WindowManager::SelectFrameInput(const Client& client) {
+  XSelectInput(m_dpy, client.m_frame, SubstructureRedirectMask | SubstructureNotifyMask);
+  XSelectInput(m_dpy, client.m_titlebar, ButtonPressMask | ButtonReleaseMask | ButtonMotionMask);
+  XSelectInput(m_dpy, client.m_closeButton, ButtonPressMask);
+  XSelectInput(m_dpy, client.m_zoomButton, ButtonPressMask);
+  XSelectInput(m_dpy, client.m_resizeHandle, ButtonPressMask | ButtonReleaseMask | ButtonMotionMask);
+
+  // Title changes
+  XSelectInput(m_dpy, client.m_client, PropertyChangeMask);
 }
 
 void WindowManager::Unframe(Window w) {
-  const Window frame = m_clients[w].m_frame;
+  auto it = m_clientIndex.find(w);
+  if (it == m_clientIndex.end()) return;
+
+  const Window frame = m_clients.Get(it->second)->m_frame;
 
   XUnmapWindow(m_dpy, w);
   XReparentWindow(m_dpy, w, m_root, 0, 0);
   XRemoveFromSaveSet(m_dpy, w);
   XDestroyWindow(m_dpy, frame);
-  m_clients.erase(w);
+  m_clients.Erase(it->second);
+  m_clientIndex.erase(it);
+
+  m_mapOrder.erase(std::find(m_mapOrder.begin(), m_mapOrder.end(), w));
+  UpdateClientList();
+  if (m_activeWindow == w) {
+    SetActiveWindow(None);
+  }
 }
 
 void WindowManager::OnMapNotify(const XMapEvent& e) {}
 
 void WindowManager::OnUnmapNotify(const XUnmapEvent& e) {
-  if (!m_clients.count(e.window)) {
+  if (!FindClientByWindow(e.window)) {
     printf("Ignore unmap notify for non-client window");
     return;
   }
@@ -335,13 +451,13 @@ void WindowManager::OnConfigureNotify(const XConfigureEvent& e) {}
 void WindowManager::OnButtonPressNotify(const XButtonEvent& e) {
   // Find which client this window belongs to and raise it
   Client* clickedClient = nullptr;
-  for (const auto& [clientWindow, client] : m_clients) {
+  for (Client& client : m_clients) {
     if (e.window == client.m_frame || 
         e.window == client.m_titlebar || 
         e.window == client.m_closeButton || 
         e.window == client.m_resizeHandle) {
-      clickedClient = const_cast<Client*>(&client);
-      // XRaiseWindow(m_dpy, client.m_frame);
+      clickedClient = &client;
+      ActivateClient(client);
 
       // Raise in correct order from bottom to top
       XRaiseWindow(m_dpy, clickedClient->m_client);
@@ -358,7 +474,8 @@ void WindowManager::OnButtonPressNotify(const XButtonEvent& e) {
     }
   }
 
-  for (const auto& [clientWindow, client] : m_clients) {
+  for (size_t i = 0; i < m_clients.Size(); i++) {
+    const Client& client = m_clients.At(i);
     if (e.window == client.m_closeButton) {
       // Send a WM_DELETE_WINDOW message to the client to request it to close
       XEvent ev;
@@ -375,7 +492,7 @@ void WindowManager::OnButtonPressNotify(const XButtonEvent& e) {
     }
 
     if (e.window == client.m_titlebar) {
-      s_dragWin = client;
+      m_dragClient = m_clients.HandleAt(i);
       m_mouseX = e.x_root;
       m_mouseY = e.y_root;
 
@@ -392,8 +509,7 @@ void WindowManager::OnButtonPressNotify(const XButtonEvent& e) {
     }
 
     if (e.window == client.m_resizeHandle) {
-      s_resizeWin = client;
-      m_isResizing = true;
+      m_resizeClient = m_clients.HandleAt(i);
       m_mouseX = e.x_root;
       m_mouseY = e.y_root;
 
@@ -411,8 +527,8 @@ void WindowManager::OnButtonPressNotify(const XButtonEvent& e) {
 void WindowManager::OnButtonReleaseNotify(const XButtonEvent& e) {
   if (e.button == Button1) {
     // Handle snap zones when releasing drag
-    if (s_dragWin.m_frame != None) {
-      Client* client = FindClientByFrame(s_dragWin.m_frame);
+    if (!m_dragClient.IsNull()) {
+      Client* client = m_clients.Get(m_dragClient);
       if (client && client->m_snapState == NONE) {
         // Check for snap zones
         if (e.x_root < 50) {
@@ -421,15 +537,22 @@ void WindowManager::OnButtonReleaseNotify(const XButtonEvent& e) {
           SnapWindow(client->m_client, RIGHT_SNAP);
         } else if (e.y_root < 10) {
           SnapWindow(client->m_client, MAXIMIZED);
+        } else {
+          SaveSession(*client);
+          PublishWindowState();
         }
       }
-      s_dragWin = {};
+      m_dragClient = {};
       printf("Stopped dragging window.\n");
     }
     
-    if (m_isResizing && s_resizeWin.m_frame != None) {
-      m_isResizing = false;
-      s_resizeWin = {};
+    if (!m_resizeClient.IsNull()) {
+      Client* client = m_clients.Get(m_resizeClient);
+      if (client) {
+        SaveSession(*client);
+        PublishWindowState();
+      }
+      m_resizeClient = {};
       printf("Stopped resizing window.\n");
     }
   }
@@ -437,45 +560,44 @@ void WindowManager::OnButtonReleaseNotify(const XButtonEvent& e) {
 
 void WindowManager::OnMotionNotify(const XMotionEvent& e) {
   if (e.state & Button1Mask) {
-    if (s_dragWin.m_frame != None) {
-      Client* client = FindClientByFrame(s_dragWin.m_frame);
-      if (client) {
-        // If window is snapped, restore it when starting to drag
-        if (client->m_snapState != NONE) {
-          RestoreWindow(client->m_client);
-          
-          // Recalculate drag offset for restored window
-          XWindowAttributes attr;
-          XGetWindowAttributes(m_dpy, client->m_frame, &attr);
-          m_dragOffsetX = attr.width / 2;  // Center under cursor
-          m_dragOffsetY = 12;  // Titlebar center
-        }
-        
-        // Calculate new position
-        int newX = e.x_root - m_dragOffsetX;
-        int newY = e.y_root - m_dragOffsetY;
-        
-        // Keep window on screen
-        newX = std::max(0, std::min(newX, m_screenWidth - 100));
-        newY = std::max(0, std::min(newY, m_screenHeight - 50));
+    if (Client* client = m_clients.Get(m_dragClient)) {
+      // If window is snapped, restore it when starting to drag
+      if (client->m_snapState != NONE) {
+        RestoreWindow(client->m_client);
         
-        XMoveWindow(m_dpy, s_dragWin.m_frame, newX, newY);
+        // Recalculate drag offset for restored window
+        XWindowAttributes attr;
+        XGetWindowAttributes(m_dpy, client->m_frame, &attr);
+        m_dragOffsetX = attr.width / 2;  // Center under cursor
+        m_dragOffsetY = 12;  // Titlebar center
       }
+      
+      // Calculate new position
+      int newX = e.x_root - m_dragOffsetX;
+      int newY = e.y_root - m_dragOffsetY;
+      
+      // Keep window on screen
+      newX = std::max(0, std::min(newX, m_screenWidth - 100));
+      newY = std::max(0, std::min(newY, m_screenHeight - 50));
+      
+      XMoveWindow(m_dpy, client->m_frame, newX, newY);
+      client->m_position = { newX, newY };
     }
     
-    if (m_isResizing && s_resizeWin.m_frame != None) {
+    if (Client* client = m_clients.Get(m_resizeClient)) {
       int deltaX = e.x_root - m_mouseX;
       int deltaY = e.y_root - m_mouseY;
       
       int newWidth = std::max(100, m_winStartX + deltaX);
       int newHeight = std::max(80, m_winStartY + deltaY);
       
-      XResizeWindow(m_dpy, s_resizeWin.m_frame, newWidth, newHeight);
-      XResizeWindow(m_dpy, s_resizeWin.m_client, newWidth, newHeight - 24);
-      XResizeWindow(m_dpy, s_resizeWin.m_titlebar, newWidth, 24);
+      XResizeWindow(m_dpy, client->m_frame, newWidth, newHeight);
+      client->m_size = { newWidth, newHeight };
+      XResizeWindow(m_dpy, client->m_client, newWidth, newHeight - 24);
+      XResizeWindow(m_dpy, client->m_titlebar, newWidth, 24);
       
       // Move resize handle to new position
-      XMoveWindow(m_dpy, s_resizeWin.m_resizeHandle, 
+      XMoveWindow(m_dpy, client->m_resizeHandle, 
                  newWidth - 12, newHeight - 12);
     }
   }
@@ -484,6 +606,12 @@ void WindowManager::OnMotionNotify(const XMotionEvent& e) {
 void WindowManager::OnKeyPressNotify(const XKeyEvent& e) {
   KeySym key = XLookupKeysym((XKeyEvent*)&e, 0);
   
+  // Super+Shift+R re-executes the window manager in place
+  if ((e.state & Mod4Mask) && (e.state & ShiftMask) && key == XK_r) {
+    Restart();
+    return;
+  }
+
   // Super (Windows) key shortcuts for window snapping
   if (e.state & Mod4Mask) {  // Mod4 is typically the Super/Windows key
     Window focused;
@@ -510,10 +638,141 @@ void WindowManager::OnKeyPressNotify(const XKeyEvent& e) {
   }
 }
 
+void WindowManager::OnClientMessage(const XClientMessageEvent& e) {
+  // Sent to the root window by e.g. an upgrade script
+  if (e.message_type == m_restartAtom) {
+    Restart();
+    return;
+  }
+
+  // Pager or task switcher asking for a window to be brought forward
+  if (e.message_type == m_netActiveWindow) {
+    Client* client = FindClientByWindow(e.window);
+    if (client) {
+      ActivateClient(*client);
+    }
+  }
+}
+
+void WindowManager::OnPropertyNotify(const XPropertyEvent& e) {
+  if (e.atom != XA_WM_NAME && e.atom != m_netWmName) return;
+
+  Client* client = FindClientByWindow(e.window);
+  if (!client) return;
+
+  std::string title = FetchTitle(e.window);
+  if (title == client->m_title) return;
+
+  client->m_title = title;
+  XStoreName(m_dpy, client->m_frame, title.c_str());
+  XClearArea(m_dpy, client->m_titlebar, 0, 0, 0, 0, False);
+  setupTitleText(client->m_titlebar, title);
+  PublishWindowState();
+}
+
+/*
+ * Advertise what we maintain on the root window and publish the current
+ * client list, e.g. after adopting clients on restart.
+ */
+void WindowManager::SetupEwmh() {
+  Atom supported[] = { m_netSupported, m_netClientList, m_netActiveWindow };
+  XChangeProperty(m_dpy, m_root, m_netSupported, XA_ATOM, 32, PropModeReplace,
+                  (unsigned char*)supported, sizeof(supported) / sizeof(supported[0]));
+
+  UpdateClientList();
+  XChangeProperty(m_dpy, m_root, m_netActiveWindow, XA_WINDOW, 32, PropModeReplace,
+                  (unsigned char*)&m_activeWindow, 1);
+}
+
+void WindowManager::UpdateClientList() {
+  XChangeProperty(m_dpy, m_root, m_netClientList, XA_WINDOW, 32, PropModeReplace,
+                  (unsigned char*)m_mapOrder.data(), m_mapOrder.size());
+  PublishWindowState();
+}
+
+void WindowManager::ActivateClient(const Client& client) {
+  XRaiseWindow(m_dpy, client.m_frame);
+  XSetInputFocus(m_dpy, client.m_client, RevertToPointerRoot, CurrentTime);
+  SetActiveWindow(client.m_client);
+}
+
+void WindowManager::SetActiveWindow(Window w) {
+  // Listeners repaint on every PropertyNotify, so skip no-op updates
+  if (w == m_activeWindow) return;
+  m_activeWindow = w;
+
+  XChangeProperty(m_dpy, m_root, m_netActiveWindow, XA_WINDOW, 32, PropModeReplace,
+                  (unsigned char*)&m_activeWindow, 1);
+  PublishWindowState();
+}
+
+/*
+ * Write the whole client list to shared memory for the bar and other panels.
+ * Everything comes from our own bookkeeping, so this costs no round trips.
+ */
+void WindowManager::PublishWindowState() {
+  std::vector<InWM::WindowStateEntry> entries;
+  entries.reserve(m_mapOrder.size());
+
+  for (Window w : m_mapOrder) {
+    const Client* client = FindClientByWindow(w);
+    if (!client) continue;
+
+    InWM::WindowStateEntry entry = {};
+    entry.m_id = client->m_client;
+    entry.m_x = client->m_position.x;
+    entry.m_y = client->m_position.y;
+    entry.m_width = client->m_size.x;
+    entry.m_height = client->m_size.y;
+    entry.m_workspace = 0;
+    entry.m_focused = client->m_client == m_activeWindow;
+    entry.m_snapState = client->m_snapState;
+
+    // Cut at a character boundary
+    size_t length = std::min(client->m_title.size(), sizeof(entry.m_title));
+    while (length > 0 && length < client->m_title.size() &&
+           (client->m_title[length] & 0xC0) == 0x80) {
+      length--;
+    }
+    memcpy(entry.m_title, client->m_title.data(), length);
+    entry.m_titleLength = length;
+
+    entries.push_back(entry);
+  }
+
+  m_windowState.publish(entries);
+}
+
+std::string WindowManager::FetchTitle(Window w) {
+  Atom type;
+  int format;
+  unsigned long count, after;
+  unsigned char* data = nullptr;
+
+  // Prefer the UTF-8 name, fall back to WM_NAME
+  if (XGetWindowProperty(m_dpy, w, m_netWmName, 0, 256, False, m_utf8String,
+                         &type, &format, &count, &after, &data) == Success &&
+      data && format == 8 && count > 0) {
+    std::string title(reinterpret_cast<char*>(data), count);
+    XFree(data);
+    return title;
+  }
+  if (data) XFree(data);
+
+  char* name = nullptr;
+  std::string title;
+  if (XFetchName(m_dpy, w, &name) && name) {
+    title = name;
+    XFree(name);
+  }
+  return title;
+}
+
 void WindowManager::SnapWindow(Window clientWindow, SnapState state) {
-  if (!m_clients.count(clientWindow)) return;
+  Client* found = FindClientByWindow(clientWindow);
+  if (!found) return;
   
-  Client& client = m_clients[clientWindow];
+  Client& client = *found;
   
   // Save current state before snapping
   if (client.m_snapState == NONE) {
@@ -551,6 +810,8 @@ void WindowManager::SnapWindow(Window clientWindow, SnapState state) {
   client.m_snapState = state;
   
   XMoveResizeWindow(m_dpy, client.m_frame, newX, newY, newWidth, newHeight);
+  client.m_position = { newX, newY };
+  client.m_size = { newWidth, newHeight };
   XResizeWindow(m_dpy, client.m_client, newWidth, newHeight - 24);
   XResizeWindow(m_dpy, client.m_titlebar, newWidth, 24);
   
@@ -560,15 +821,19 @@ void WindowManager::SnapWindow(Window clientWindow, SnapState state) {
   // Move resize handle to new position
   XMoveWindow(m_dpy, client.m_resizeHandle, newWidth - 12, newHeight - 12);
   
+  SaveSession(client);
+  PublishWindowState();
+  
   printf("Snapped window to %s\n", 
          state == LEFT_SNAP ? "left" : 
          state == RIGHT_SNAP ? "right" : "maximized");
 }
 
 void WindowManager::RestoreWindow(Window clientWindow) {
-  if (!m_clients.count(clientWindow)) return;
+  Client* found = FindClientByWindow(clientWindow);
+  if (!found) return;
   
-  Client& client = m_clients[clientWindow];
+  Client& client = *found;
   
   if (client.m_snapState == NONE) return;
   
@@ -577,6 +842,8 @@ void WindowManager::RestoreWindow(Window clientWindow) {
   XMoveResizeWindow(m_dpy, client.m_frame, 
                    client.m_posBeforeSnap.x, client.m_posBeforeSnap.y,
                    client.m_sizeBeforeSnap.x, client.m_sizeBeforeSnap.y);
+  client.m_position = client.m_posBeforeSnap;
+  client.m_size = client.m_sizeBeforeSnap;
   
   XResizeWindow(m_dpy, client.m_client, 
                client.m_sizeBeforeSnap.x, client.m_sizeBeforeSnap.y - 24);
@@ -589,11 +856,14 @@ void WindowManager::RestoreWindow(Window clientWindow) {
   XMoveWindow(m_dpy, client.m_resizeHandle, 
              client.m_sizeBeforeSnap.x - 12, client.m_sizeBeforeSnap.y - 12);
   
+  SaveSession(client);
+  PublishWindowState();
+  
   printf("Restored window to original size\n");
 }
 
 Client* WindowManager::FindClientByFrame(Window frame) {
-  for (auto& [clientWindow, client] : m_clients) {
+  for (Client& client : m_clients) {
     if (client.m_frame == frame) {
       return &client;
     }
@@ -602,27 +872,260 @@ Client* WindowManager::FindClientByFrame(Window frame) {
 }
 
 Client* WindowManager::FindClientByWindow(Window window) {
-  if (m_clients.count(window)) {
-    return &m_clients[window];
+  auto it = m_clientIndex.find(window);
+  if (it != m_clientIndex.end()) {
+    return m_clients.Get(it->second);
   }
   return nullptr;
 }
 
+void WindowManager::SaveSession(const Client& client) {
+  if (client.m_sessionKey == 0) return;
+
+  XWindowAttributes attr;
+  if (!XGetWindowAttributes(m_dpy, client.m_frame, &attr)) return;
+
+  SessionEntry entry = {
+    client.m_sessionKey,
+    attr.x, attr.y, attr.width, attr.height,
+    client.m_snapState,
+    { client.m_posBeforeSnap.x, client.m_posBeforeSnap.y },
+    { client.m_sizeBeforeSnap.x, client.m_sizeBeforeSnap.y }
+  };
+  m_session.Update(entry);
+}
+
 void WindowManager::setupTitleText(Window titlebar, const std::string& title) {
-  // Create a graphics context for the title bar
-  GC gc = XCreateGC(m_dpy, titlebar, 0, nullptr);
-  
-  // System 7 used Chicago font (use a sans-serif substitute)
-  Font font = XLoadFont(m_dpy, "-*-helvetica-medium-r-normal-*-12-*-*-*-*-*-*-*");
-  XSetFont(m_dpy, gc, font);
-  
-  // Set colors: black text with white drop shadow for 3D effect
-  XSetForeground(m_dpy, gc, 0xFFFFFF);  // White shadow
-  XDrawString(m_dpy, titlebar, gc, 33, 15, title.c_str(), title.length());
+  // System 7 used Chicago font (use a sans-serif substitute). Loaded once.
+  InWM::Font* font = InWM::Font::get(m_dpy, "-*-helvetica-medium-r-normal-*-12-*-*-*-*-*-*-*");
   
-  XSetForeground(m_dpy, gc, 0x000000);  // Black text
-  XDrawString(m_dpy, titlebar, gc, 32, 14, title.c_str(), title.length());
+  // Black text with white drop shadow for 3D effect, each color with its
+  // own shared GC
+  GC shadow = InWM::GCCache::get(m_dpy, 0xFFFFFF, font);
+  XDrawString(m_dpy, titlebar, shadow, 33, 15, title.c_str(), title.length());
   
-  // XFreeFont(m_dpy, font);
-  XFreeGC(m_dpy, gc);
-}
\ No newline at end of file
+  GC text = InWM::GCCache::get(m_dpy, 0x000000, font);
+  XDrawString(m_dpy, titlebar, text, 32, 14, title.c_str(), title.length());
+}
+
+/*
+ * Hot restart
+ *
+ * The client table is written to a memfd that survives exec(). Our frames
+ * are kept alive by RetainPermanent close-down mode, and clients are taken
+ * out of the save-set first so the server does not reparent them to the root
+ * when our connection goes away. The new process picks the frames back up in
+ * RestoreState() without creating, destroying or remapping any window.
+ */
+namespace {
+
+const uint32_t STATE_MAGIC = 0x4d574e49;  // "INWM"
+const uint32_t STATE_VERSION = 3;
+
+struct StateHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t activeWindow;
+};
+
+struct StateRecord {
+  uint32_t client;
+  uint32_t frame;
+  uint32_t closeButton;
+  uint32_t zoomButton;
+  uint32_t titlebar;
+  uint32_t resizeHandle;
+  int32_t snapState;
+  int32_t sizeBeforeSnap[2];
+  int32_t posBeforeSnap[2];
+  uint64_t sessionKey;
+  uint32_t mapIndex;     // Position in m_mapOrder, records are in stacking order
+  uint32_t titleLength;  // Title bytes follow the record
+};
+
+}
+
+void WindowManager::Restart() {
+  int fd = memfd_create("inwm-state", 0);  // No CLOEXEC, exec must inherit it
+  if (fd < 0) {
+    perror("memfd_create");
+    return;
+  }
+
+  SaveState(fd);
+  lseek(fd, 0, SEEK_SET);
+
+  for (const Client& client : m_clients) {
+    XRemoveFromSaveSet(m_dpy, client.m_client);
+    ClearFrameInput(client.m_frame, client.m_client);
+  }
+
+  // Everything still allocated is kept for good once the connection is
+  // retained, and would keep the old client alive after our successor
+  // destroys the last adopted frame. Both are recreated on demand if the
+  // exec fails.
+  InWM::GCCache::release(m_dpy);
+  InWM::Font::release(m_dpy);
+  XSetCloseDownMode(m_dpy, RetainPermanent);
+  XSync(m_dpy, False);
+
+  // Make sure the connection closes on exec so the root can be taken over
+  fcntl(ConnectionNumber(m_dpy), F_SETFD, FD_CLOEXEC);
+  setenv("INWM_RESTART_FD", std::to_string(fd).c_str(), 1);
+
+  printf("Restarting with %zu clients\n", m_clients.Size());
+  execvp(m_argv[0], m_argv);
+
+  // Still here, carry on as if nothing happened
+  perror("execvp");
+  unsetenv("INWM_RESTART_FD");
+  close(fd);
+
+  XSetCloseDownMode(m_dpy, DestroyAll);
+  for (const Client& client : m_clients) {
+    XAddToSaveSet(m_dpy, client.m_client);
+    SelectFrameInput(client);
+  }
+}
+
+void WindowManager::SaveState(int fd) {
+  // Record clients bottom to top, the order they are stacked on the root
+  std::vector<const Client*> stacked;
+  Window rootReturn, parentReturn;
+  Window* children = nullptr;
+  unsigned int count = 0;
+  if (XQueryTree(m_dpy, m_root, &rootReturn, &parentReturn, &children, &count)) {
+    for (unsigned int i = 0; i < count; i++) {
+      Client* client = FindClientByFrame(children[i]);
+      if (client) stacked.push_back(client);
+    }
+    XFree(children);
+  }
+
+  std::vector<char> buffer;
+  StateHeader header = { STATE_MAGIC, STATE_VERSION, (uint32_t)stacked.size(),
+                         (uint32_t)m_activeWindow };
+  buffer.insert(buffer.end(), (char*)&header, (char*)&header + sizeof(header));
+
+  for (const Client* client : stacked) {
+    size_t mapIndex = std::find(m_mapOrder.begin(), m_mapOrder.end(), client->m_client) -
+                      m_mapOrder.begin();
+    StateRecord record = {
+      (uint32_t)client->m_client,
+      (uint32_t)client->m_frame,
+      (uint32_t)client->m_closeButton,
+      (uint32_t)client->m_zoomButton,
+      (uint32_t)client->m_titlebar,
+      (uint32_t)client->m_resizeHandle,
+      client->m_snapState,
+      { client->m_sizeBeforeSnap.x, client->m_sizeBeforeSnap.y },
+      { client->m_posBeforeSnap.x, client->m_posBeforeSnap.y },
+      client->m_sessionKey,
+      (uint32_t)mapIndex,
+      (uint32_t)client->m_title.size()
+    };
+    buffer.insert(buffer.end(), (char*)&record, (char*)&record + sizeof(record));
+    buffer.insert(buffer.end(), client->m_title.begin(), client->m_title.end());
+  }
+
+  if (write(fd, buffer.data(), buffer.size()) != (ssize_t)buffer.size()) {
+    perror("write restart state");
+  }
+}
+
+void WindowManager::RestoreState(int fd) {
+  std::vector<char> buffer;
+  char chunk[4096];
+  ssize_t n;
+  while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+    buffer.insert(buffer.end(), chunk, chunk + n);
+  }
+  close(fd);
+
+  StateHeader header;
+  if (buffer.size() < sizeof(header)) return;
+  memcpy(&header, buffer.data(), sizeof(header));
+  if (header.magic != STATE_MAGIC || header.version != STATE_VERSION) {
+    printf("Ignoring restart state from an incompatible version\n");
+    return;
+  }
+
+  // Clients by their place in the old map order, to rebuild it oldest first
+  std::vector<std::pair<uint32_t, Window>> mapped;
+
+  size_t offset = sizeof(header);
+  for (uint32_t i = 0; i < header.count; i++) {
+    StateRecord record;
+    if (offset + sizeof(record) > buffer.size()) break;
+    memcpy(&record, buffer.data() + offset, sizeof(record));
+    offset += sizeof(record);
+
+    if (offset + record.titleLength > buffer.size()) break;
+    std::string title(buffer.data() + offset, record.titleLength);
+    offset += record.titleLength;
+
+    // Skip clients that went away while we were restarting
+    XWindowAttributes attr;
+    if (!XGetWindowAttributes(m_dpy, record.client, &attr) ||
+        !XGetWindowAttributes(m_dpy, record.frame, &attr)) {
+      continue;
+    }
+
+    // Without a valid state the saved geometry means nothing either
+    bool snapped = record.snapState != NONE && IsSnapState(record.snapState);
+    SlotHandle handle = m_clients.Insert({
+      .m_frame = record.frame,
+      .m_client = record.client,
+      .m_closeButton = record.closeButton,
+      .m_zoomButton = record.zoomButton,
+      .m_titlebar = record.titlebar,
+      .m_resizeHandle = record.resizeHandle,
+      .m_title = title,
+      .m_position = { attr.x, attr.y },
+      .m_size = { attr.width, attr.height },
+      .m_snapState = snapped ? (SnapState)record.snapState : NONE,
+      .m_sizeBeforeSnap = snapped ?
+        Vector2D { record.sizeBeforeSnap[0], record.sizeBeforeSnap[1] } :
+        Vector2D { attr.width, attr.height },
+      .m_posBeforeSnap = snapped ?
+        Vector2D { record.posBeforeSnap[0], record.posBeforeSnap[1] } :
+        Vector2D { attr.x, attr.y },
+      .m_sessionKey = record.sessionKey
+    });
+    m_clientIndex[record.client] = handle;
+    mapped.emplace_back(record.mapIndex, record.client);
+
+    XAddToSaveSet(m_dpy, record.client);
+    SelectFrameInput(*m_clients.Get(handle));
+  }
+
+  std::sort(mapped.begin(), mapped.end());
+  for (const auto& entry : mapped) {
+    m_mapOrder.push_back(entry.second);
+  }
+
+  // SetupEwmh() publishes it along with the client list
+  if (m_clientIndex.count(header.activeWindow)) {
+    m_activeWindow = header.activeWindow;
+  }
+
+  printf("Adopted %zu clients after restart\n", m_clients.Size());
+}
+
+void WindowManager::ClearFrameInput(Window w, Window client) {
+  // Selections on windows we created outlive a retained connection, and
+  // redirect/button masks are exclusive, so drop them for our successor
+  if (w == client) return;
+  XSelectInput(m_dpy, w, NoEventMask);
+
+  Window rootReturn, parentReturn;
+  Window* children = nullptr;
+  unsigned int count = 0;
+  if (XQueryTree(m_dpy, w, &rootReturn, &parentReturn, &children, &count)) {
+    for (unsigned int i = 0; i < count; i++) {
+      ClearFrameInput(children[i], client);
+    }
+    XFree(children);
+  }
+}
@@ -7,6 +7,10 @@ extern "C" {
 #include <memory>
 #include <unordered_map>
 #include <string>
+#include <vector>
+#include "Session.hpp"
+#include "SlotMap.hpp"
+#include "lib/WindowState.hpp"
 
 struct Vector2D {
   int x;
@@ -24,12 +28,16 @@ struct Client {
   Window m_frame;
   Window m_client;
   Window m_closeButton;
+  Window m_zoomButton;
   Window m_titlebar;
   Window m_resizeHandle;  // Bottom-right resize handle
   std::string m_title;
+  Vector2D m_position;  // Frame geometry as we last set it
+  Vector2D m_size;
   SnapState m_snapState;
   Vector2D m_sizeBeforeSnap;
   Vector2D m_posBeforeSnap;
+  uint64_t m_sessionKey;  // Placement key in the session store, 0 if none
 };
 
 class WindowManager {
@@ -38,8 +46,8 @@ class WindowManager {
      * Factory method for establishing a connection to an X server and creating
      * a Window Manager instance.
      */
-    static std::unique_ptr<WindowManager> Create();
-    std::unordered_map<Window, Client> m_clients;
+    static std::unique_ptr<WindowManager> Create(char** argv);
+    SlotMap<Client> m_clients;
 
     /*
      * Disconnect from the X server.
@@ -52,7 +60,7 @@ class WindowManager {
     /*
      * Invoke internally by Create()
      */
-    WindowManager(Display* dpy);
+    WindowManager(Display* dpy, char** argv);
 
     /*
      * Handle to the underlying Xlib Display struct.
@@ -64,19 +72,38 @@ class WindowManager {
      */
     const Window m_root;
 
+    /*
+     * Command line used to re-exec ourselves on restart.
+     */
+    char** m_argv;
+    Atom m_restartAtom;
+
+    /*
+     * EWMH atoms the bar's task switcher watches on the root window.
+     */
+    Atom m_netSupported;
+    Atom m_netClientList;
+    Atom m_netActiveWindow;
+    Atom m_netWmName;
+    Atom m_utf8String;
+
     static int OnXError(Display* dpy, XErrorEvent* e);
     static int OnWMDetected(Display* dpy, XErrorEvent* e);
     static bool m_wmDetected;
 
-    static Client s_dragWin;
-    static Client s_resizeWin;
+    std::unordered_map<Window, SlotHandle> m_clientIndex;  // Client window to m_clients
+    std::vector<Window> m_mapOrder;  // Client windows, oldest first, for _NET_CLIENT_LIST
+    Window m_activeWindow;
+    SlotHandle m_dragClient;    // Client being dragged by its titlebar
+    SlotHandle m_resizeClient;  // Client being resized by its handle
     static int m_mouseX, m_mouseY;
     int m_winStartX;  // Window's initial X position when dragging starts
     int m_winStartY;  // Window's initial Y position when dragging starts
     int m_dragOffsetX;  // Offset between mouse and window X position
     int m_dragOffsetY;  // Offset between mouse and window Y position
     int m_screenWidth, m_screenHeight;  // Screen dimensions
-    bool m_isResizing;  // Track resize state
+    SessionStore m_session;  // Window placement saved across logins
+    InWM::WindowStateWriter m_windowState;  // Window list for panels, in shared memory
     
     /* Event handlers */
     void OnCreateNotify(const XCreateWindowEvent& e);
@@ -91,16 +118,34 @@ class WindowManager {
     void OnButtonReleaseNotify(const XButtonEvent& e);
     void OnMotionNotify(const XMotionEvent& e);
     void OnKeyPressNotify(const XKeyEvent& e);
+    void OnClientMessage(const XClientMessageEvent& e);
+    void OnPropertyNotify(const XPropertyEvent& e);
     
     /* Helper functions */
     void SnapWindow(Window clientWindow, SnapState state);
     void RestoreWindow(Window clientWindow);
     Client* FindClientByFrame(Window frame);
     Client* FindClientByWindow(Window window);
+    void SaveSession(const Client& client);
+
+    /* EWMH root properties */
+    void SetupEwmh();
+    void UpdateClientList();
+    void ActivateClient(const Client& client);
+    void SetActiveWindow(Window w);
+    void PublishWindowState();
+    std::string FetchTitle(Window w);
 
     void Frame(Window w, const std::string& title = "");
     void Unframe(Window w);
     void setupTitleText(Window titlebar, const std::string& title);
+
+    /* Hot restart */
+    void Restart();
+    void SaveState(int fd);
+    void RestoreState(int fd);
+    void ClearFrameInput(Window w, Window client);
+    void SelectFrameInput(const Client& client);
     void drawWindowTitle(Window titlebar, const std::string& title);
 };
 
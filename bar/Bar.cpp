@@ -1,24 +1,107 @@
 #include "Bar.hpp"
+#include "../lib/WorkerPool.hpp"
+#include <algorithm>
+#include <climits>
 #include <ctime>
 #include <cstring>
 #include <cstdio>
+#include <unordered_map>
+#include <poll.h>
+#include <sys/resource.h>
 extern "C" {
 #include <X11/Xatom.h>
 }
 
-Bar::Bar(Display* dpy, Window root) : m_dpy(dpy), m_root(root) {
+volatile sig_atomic_t Bar::s_dumpStats = 0;
+
+Bar::Bar(Display* dpy, Window root)
+: m_dpy(dpy), m_root(root), m_width(0), m_buffer(None), m_gc(nullptr),
+  m_font(InWM::Font::get(dpy)), m_dirty(0),
+  m_icons(dpy, ICON_SIZE, 0xC0C0C0), m_activeWindow(None),
+  m_modules(CreateStatusModules()), m_stats() {
+  m_stats.m_start = MonotonicMs();
+
+  m_netClientList = XInternAtom(m_dpy, "_NET_CLIENT_LIST", False);
+  m_netActiveWindow = XInternAtom(m_dpy, "_NET_ACTIVE_WINDOW", False);
+  m_netWmName = XInternAtom(m_dpy, "_NET_WM_NAME", False);
+  m_netWmIcon = XInternAtom(m_dpy, "_NET_WM_ICON", False);
+  m_utf8String = XInternAtom(m_dpy, "UTF8_STRING", False);
+
+  XSetErrorHandler(&Bar::OnXError);
   CreateWindow();
+
+  // No SA_RESTART, so poll() returns and the loop prints the stats
+  struct sigaction action = {};
+  action.sa_handler = &Bar::OnSigUsr1;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGUSR1, &action, nullptr);
+
+  // Converted icons arrive asynchronously, repaint just their button
+  m_icons.SetReadyCallback([this](Window w) {
+    int slot = FindTask(w);
+    if (slot >= 0) {
+      MarkTaskDirty(slot);
+    }
+  });
+
+  // inwm publishes the window list in shared memory; other window managers
+  // only keep it in root window properties
+  if (!OpenWindowState()) {
+    XSelectInput(m_dpy, m_root, PropertyChangeMask);
+  }
+  UpdateTasks();
+}
+
+bool Bar::OpenWindowState() {
+  if (m_windowState.isOpen()) return true;
+  if (!m_windowState.open(m_dpy)) return false;
+
+  m_windowState.watch([this]() { UpdateTasks(); });
+  XSelectInput(m_dpy, m_root, NoEventMask);
+  return true;
 }
 
 Bar::~Bar() {
   DestroyWindow();
+  InWM::GCCache::release(m_dpy);
+  InWM::Font::release(m_dpy);
 }
 
 void Bar::Run() {
   XEvent ev;
+  InWM::WorkerPool& pool = InWM::WorkerPool::shared();
+
   while (true) {
-    XNextEvent(m_dpy, &ev);
-    HandleEvent(&ev);
+    while (XPending(m_dpy)) {
+      XNextEvent(m_dpy, &ev);
+      HandleEvent(&ev);
+      m_stats.m_events++;
+    }
+
+    // Results of background work are applied here, once per iteration
+    m_stats.m_completions += pool.runCompletions();
+    if (XPending(m_dpy)) continue;
+
+    if (s_dumpStats) {
+      s_dumpStats = 0;
+      DumpStats();
+    }
+
+    UpdateClock();
+    int timeout = std::min(MsUntilNextMinute(), SampleModules());
+    Paint();
+    XFlush(m_dpy);
+
+    pollfd fds[2] = {
+      { ConnectionNumber(m_dpy), POLLIN, 0 },
+      { pool.completionFd(), POLLIN, 0 }
+    };
+    int ready = poll(fds, 2, timeout);
+
+    m_stats.m_wakeups++;
+    if (ready == 0) m_stats.m_timerWakeups++;
+    if (fds[0].revents) m_stats.m_xWakeups++;
+    if (fds[1].revents) m_stats.m_workerWakeups++;
   }
 }
 
@@ -29,6 +112,7 @@ void Bar::CreateWindow() {
   int screenHeight = HeightOfScreen(screen);
   
   // Create bar at top of screen with System 8-like appearance
+  m_width = screenWidth;
   m_win = XCreateSimpleWindow(m_dpy, m_root, 0, 0, screenWidth, 24, 0, 0x808080, 0xC0C0C0);
   
   // Set window properties to behave like a dock/panel
@@ -43,55 +127,258 @@ void Bar::CreateWindow() {
   XChangeProperty(m_dpy, m_win, wmStrut, XA_CARDINAL, 32, PropModeReplace,
                   (unsigned char*)&strut, 4);
   
-  XSelectInput(m_dpy, m_win, ExposureMask | ButtonPressMask);
+  // Copies from the back-buffer never need GraphicsExpose
+  XGCValues values;
+  values.graphics_exposures = False;
+  m_gc = XCreateGC(m_dpy, m_win, GCGraphicsExposures, &values);
+  CreateBuffer();
+
+  XSelectInput(m_dpy, m_win, ExposureMask | ButtonPressMask | StructureNotifyMask);
   XMapWindow(m_dpy, m_win);
   XRaiseWindow(m_dpy, m_win);
 }
 
 void Bar::DestroyWindow() {
+  XFreePixmap(m_dpy, m_buffer);
+  XFreeGC(m_dpy, m_gc);
   XDestroyWindow(m_dpy, m_win);
 }
 
-void Bar::Draw() {
-  // Get screen width
-  XWindowAttributes attr;
-  XGetWindowAttributes(m_dpy, m_win, &attr);
-  int width = attr.width;
-  
+void Bar::CreateBuffer() {
+  if (m_buffer != None) {
+    XFreePixmap(m_dpy, m_buffer);
+  }
+  m_buffer = XCreatePixmap(m_dpy, m_win, m_width, HEIGHT,
+                           DefaultDepth(m_dpy, DefaultScreen(m_dpy)));
+  m_dirty |= DIRTY_FRAME;
+}
+
+/*
+ * Bring the back-buffer up to date and copy the parts that changed.
+ */
+void Bar::Paint() {
+  bool modulesDirty = false;
+  for (const auto& module : m_modules) {
+    modulesDirty |= module->m_dirty;
+  }
+  if (!m_dirty && m_dirtySlots.empty() && !modulesDirty) return;
+
+  m_stats.m_paints++;
+  if (m_dirty & DIRTY_FRAME) {
+    PaintFrame();
+    m_dirty |= DIRTY_TASKS | DIRTY_CLOCK;
+    for (const auto& module : m_modules) {
+      module->m_dirty = true;
+    }
+  }
+
+  std::vector<XRectangle> damage;
+  size_t slots = TaskSlots();
+
+  if (m_dirty & DIRTY_TASKS) {
+    for (size_t slot = 0; slot < std::min(m_tasks.size(), slots); slot++) {
+      PaintTask(slot);
+    }
+    damage.push_back({ (short)TASKS_X, 0, (unsigned short)(slots * TASK_WIDTH), HEIGHT });
+  } else {
+    std::sort(m_dirtySlots.begin(), m_dirtySlots.end());
+    m_dirtySlots.erase(std::unique(m_dirtySlots.begin(), m_dirtySlots.end()), m_dirtySlots.end());
+    for (size_t slot : m_dirtySlots) {
+      if (slot >= slots) continue;
+      PaintTask(slot);
+      damage.push_back({ (short)(TASKS_X + slot * TASK_WIDTH), 0, TASK_WIDTH, HEIGHT });
+    }
+  }
+
+  for (size_t i = 0; i < m_modules.size(); i++) {
+    if (!m_modules[i]->m_dirty) continue;
+
+    PaintModule(i);
+    damage.push_back({ (short)ModuleX(i), 0, (unsigned short)m_modules[i]->Width(), HEIGHT });
+    m_modules[i]->m_dirty = false;
+  }
+
+  if (m_dirty & DIRTY_CLOCK) {
+    PaintClock();
+    damage.push_back({ (short)(m_width - CLOCK_WIDTH), 0, CLOCK_WIDTH, HEIGHT });
+  }
+
+  if (m_dirty & DIRTY_FRAME) {
+    XCopyArea(m_dpy, m_buffer, m_win, m_gc, 0, 0, m_width, HEIGHT, 0, 0);
+  } else {
+    for (const XRectangle& rect : damage) {
+      XCopyArea(m_dpy, m_buffer, m_win, m_gc, rect.x, rect.y, rect.width, rect.height,
+                rect.x, rect.y);
+    }
+  }
+
+  m_dirty = 0;
+  m_dirtySlots.clear();
+}
+
+/*
+ * Shared GC that draws in `color` with the bar's font.
+ */
+GC Bar::Gc(unsigned long color) const {
+  return InWM::GCCache::get(m_dpy, color, m_font);
+}
+
+void Bar::PaintFrame() {
+  int width = m_width;
+
   // Clear background with System 8 gray
-  XSetForeground(m_dpy, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 0xC0C0C0);
-  XFillRectangle(m_dpy, m_win, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 0, 0, width, 24);
+  XFillRectangle(m_dpy, m_buffer, Gc(0xC0C0C0), 0, 0, width, HEIGHT);
   
   // Draw 3D border effect
-  XSetForeground(m_dpy, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 0xFFFFFF); // White highlight
-  XDrawLine(m_dpy, m_win, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 0, 0, width-1, 0); // top
-  XDrawLine(m_dpy, m_win, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 0, 0, 0, 23); // left
+  GC highlight = Gc(0xFFFFFF); // White highlight
+  XDrawLine(m_dpy, m_buffer, highlight, 0, 0, width-1, 0); // top
+  XDrawLine(m_dpy, m_buffer, highlight, 0, 0, 0, HEIGHT-1); // left
   
-  XSetForeground(m_dpy, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 0x808080); // Dark gray shadow
-  XDrawLine(m_dpy, m_win, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 0, 23, width-1, 23); // bottom
-  XDrawLine(m_dpy, m_win, DefaultGC(m_dpy, DefaultScreen(m_dpy)), width-1, 0, width-1, 23); // right
+  GC shadow = Gc(0x808080); // Dark gray shadow
+  XDrawLine(m_dpy, m_buffer, shadow, 0, HEIGHT-1, width-1, HEIGHT-1); // bottom
+  XDrawLine(m_dpy, m_buffer, shadow, width-1, 0, width-1, HEIGHT-1); // right
   
   // Draw Apple menu (black text)
-  XSetForeground(m_dpy, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 0x000000);
-  XDrawString(m_dpy, m_win, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 8, 16, "\xEF\x82\x8F", 3); // Apple logo (if font supports it)
+  GC text = Gc(0x000000);
+  XDrawString(m_dpy, m_buffer, text, 8, 16, "\xEF\x82\x8F", 3); // Apple logo (if font supports it)
   
   // Draw menu items
-  XDrawString(m_dpy, m_win, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 35, 16, "File", 4);
-  XDrawString(m_dpy, m_win, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 70, 16, "Edit", 4);
-  XDrawString(m_dpy, m_win, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 105, 16, "View", 4);
-  XDrawString(m_dpy, m_win, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 140, 16, "Special", 7);
-  
-  // Draw time on the right side
+  XDrawString(m_dpy, m_buffer, text, 35, 16, "File", 4);
+  XDrawString(m_dpy, m_buffer, text, 70, 16, "Edit", 4);
+  XDrawString(m_dpy, m_buffer, text, 105, 16, "View", 4);
+  XDrawString(m_dpy, m_buffer, text, 140, 16, "Special", 7);
+}
+
+void Bar::PaintClock() {
+  int x = m_width - CLOCK_WIDTH;
+
+  // Keep the frame's bevel on the top, bottom and right edges
+  XFillRectangle(m_dpy, m_buffer, Gc(0xC0C0C0), x, 1, CLOCK_WIDTH - 1, HEIGHT - 2);
+
+  int timeWidth = m_font->textWidth(m_clockText);
+  XDrawString(m_dpy, m_buffer, Gc(0x000000), m_width - timeWidth - 10, 16,
+              m_clockText.c_str(), m_clockText.size());
+}
+
+/*
+ * Called once per loop iteration; the poll timeout wakes us on the minute.
+ */
+void Bar::UpdateClock() {
   time_t rawtime;
-  struct tm * timeinfo;
   char timestr[80];
   time(&rawtime);
-  timeinfo = localtime(&rawtime);
-  strftime(timestr, sizeof(timestr), "%H:%M", timeinfo);
-  
-  int timeWidth = strlen(timestr) * 8; // Approximate character width
-  XDrawString(m_dpy, m_win, DefaultGC(m_dpy, DefaultScreen(m_dpy)), 
-              width - timeWidth - 10, 16, timestr, strlen(timestr));
+  strftime(timestr, sizeof(timestr), "%H:%M", localtime(&rawtime));
+
+  if (m_clockText != timestr) {
+    m_clockText = timestr;
+    m_dirty |= DIRTY_CLOCK;
+  }
+}
+
+/*
+ * Start samples that are due and return how long until the next one is.
+ * Modules with a sample in flight are woken by its completion instead.
+ */
+int Bar::SampleModules() {
+  int64_t now = MonotonicMs();
+  int64_t next = INT_MAX;
+
+  for (const auto& owned : m_modules) {
+    StatusModule* module = owned.get();
+    if (module->m_busy) continue;
+
+    if (now >= module->m_nextSample) {
+      module->m_busy = true;
+      module->m_nextSample = now + module->IntervalMs();
+
+      InWM::WorkerPool::shared().submit([module]() -> InWM::WorkerPool::Completion {
+        std::string text = module->Sample();
+        return [module, text]() {
+          module->m_busy = false;
+          module->m_samples++;
+
+          // Only a new value costs a repaint
+          if (text != module->m_text) {
+            module->m_text = text;
+            module->m_dirty = true;
+            module->m_changes++;
+          }
+        };
+      });
+      continue;
+    }
+
+    next = std::min(next, module->m_nextSample - now);
+  }
+
+  return next;
+}
+
+void Bar::PaintModule(size_t index) {
+  const StatusModule& module = *m_modules[index];
+  int x = ModuleX(index);
+
+  XFillRectangle(m_dpy, m_buffer, Gc(0xC0C0C0), x, 1, module.Width(), HEIGHT - 2);
+
+  // Etched separator on the left
+  XDrawLine(m_dpy, m_buffer, Gc(0x808080), x, 4, x, HEIGHT - 5);
+  XDrawLine(m_dpy, m_buffer, Gc(0xFFFFFF), x + 1, 4, x + 1, HEIGHT - 5);
+
+  XDrawString(m_dpy, m_buffer, Gc(0x000000), x + 6, 16, module.m_text.c_str(), module.m_text.size());
+}
+
+int Bar::ModuleX(size_t index) const {
+  int x = m_width - CLOCK_WIDTH - StatusWidth();
+  for (size_t i = 0; i < index; i++) {
+    x += m_modules[i]->Width();
+  }
+  return x;
+}
+
+int Bar::StatusWidth() const {
+  int width = 0;
+  for (const auto& module : m_modules) {
+    width += module->Width();
+  }
+  return width;
+}
+
+void Bar::DumpStats() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  double uptime = std::max<int64_t>(1, MonotonicMs() - m_stats.m_start) / 1000.0;
+  double cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+               usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+
+  fprintf(stderr, "bar: up %.0fs, %llu wakeups (%.3f/s): %llu X, %llu worker, %llu timer\n",
+          uptime, (unsigned long long)m_stats.m_wakeups, m_stats.m_wakeups / uptime,
+          (unsigned long long)m_stats.m_xWakeups, (unsigned long long)m_stats.m_workerWakeups,
+          (unsigned long long)m_stats.m_timerWakeups);
+  fprintf(stderr, "bar: %llu events, %llu completions, %llu paints\n",
+          (unsigned long long)m_stats.m_events, (unsigned long long)m_stats.m_completions,
+          (unsigned long long)m_stats.m_paints);
+  fprintf(stderr, "bar: cpu %.3fs (%.3f%%) including workers, max rss %ldK\n",
+          cpu, cpu * 100 / uptime, usage.ru_maxrss);
+
+  for (const auto& module : m_modules) {
+    fprintf(stderr, "bar: %-8s every %5dms, %llu samples, %llu changes, \"%s\"\n",
+            module->Name(), module->IntervalMs(), (unsigned long long)module->m_samples,
+            (unsigned long long)module->m_changes, module->m_text.c_str());
+  }
+}
+
+void Bar::OnSigUsr1(int signal) {
+  s_dumpStats = 1;
+}
+
+int Bar::MsUntilNextMinute() const {
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  int ms = (59 - now.tv_sec % 60) * 1000 + (999 - now.tv_nsec / 1000000);
+
+  // Land just past the boundary rather than just before it
+  return ms + 1;
 }
 
 void Bar::HandleEvent(XEvent* ev) {
@@ -102,11 +389,28 @@ void Bar::HandleEvent(XEvent* ev) {
     case ButtonPress:
       HandleButtonPress(ev);
       break;
+    case ConfigureNotify:
+      HandleConfigureNotify(ev);
+      break;
+    case PropertyNotify:
+      HandlePropertyNotify(ev);
+      break;
   }
 }
 
 void Bar::HandleExpose(XEvent* ev) {
-  Draw();
+  // The back-buffer is always complete, just copy the exposed part. Anything
+  // still dirty is copied by the next Paint()
+  XExposeEvent* ee = &ev->xexpose;
+  XCopyArea(m_dpy, m_buffer, m_win, m_gc, ee->x, ee->y, ee->width, ee->height, ee->x, ee->y);
+}
+
+void Bar::HandleConfigureNotify(XEvent* ev) {
+  XConfigureEvent* ce = &ev->xconfigure;
+  if (ce->window != m_win || ce->width == m_width) return;
+
+  m_width = ce->width;
+  CreateBuffer();
 }
 
 void Bar::HandleButtonPress(XEvent* ev) {
@@ -123,6 +427,266 @@ void Bar::HandleButtonPress(XEvent* ev) {
     printf("View menu clicked\n");
   } else if (be->x >= 140 && be->x < 190) {
     printf("Special menu clicked\n");
+  } else if (be->x >= TASKS_X) {
+    size_t slot = (be->x - TASKS_X) / TASK_WIDTH;
+    if (slot >= std::min(m_tasks.size(), TaskSlots())) return;
+
+    // Ask the window manager to raise and focus it
+    XEvent msg = {};
+    msg.xclient.type = ClientMessage;
+    msg.xclient.window = m_tasks[slot].m_window;
+    msg.xclient.message_type = m_netActiveWindow;
+    msg.xclient.format = 32;
+    msg.xclient.data.l[0] = 2;  // Source indication: pager
+    msg.xclient.data.l[1] = be->time;
+    msg.xclient.data.l[2] = m_activeWindow;
+    XSendEvent(m_dpy, m_root, False, SubstructureRedirectMask | SubstructureNotifyMask, &msg);
+    XFlush(m_dpy);
+  }
+}
+
+void Bar::HandlePropertyNotify(XEvent* ev) {
+  XPropertyEvent* pe = &ev->xproperty;
+
+  if (pe->window == m_root) {
+    if (pe->atom == m_netClientList) {
+      // inwm may have been started after us
+      OpenWindowState();
+      UpdateTasks();
+    } else if (pe->atom == m_netActiveWindow) {
+      UpdateActiveWindow();
+    }
+    return;
+  }
+
+  // Title or icon of one of the tasks
+  int slot = FindTask(pe->window);
+  if (slot < 0) return;
+
+  if ((pe->atom == XA_WM_NAME || pe->atom == m_netWmName) && !m_windowState.isOpen()) {
+    std::string title = FetchTitle(pe->window);
+    if (title != m_tasks[slot].m_title) {
+      m_tasks[slot].m_title = title;
+      MarkTaskDirty(slot);
+    }
+  } else if (pe->atom == m_netWmIcon) {
+    m_icons.Invalidate(pe->window);
+    MarkTaskDirty(slot);
+  }
+}
+
+/*
+ * Re-read the window list and diff it against what is on screen. With inwm
+ * the list, titles and focus come from shared memory; otherwise from root
+ * window properties, where windows we already know keep their title so only
+ * new ones cost a round trip.
+ */
+void Bar::UpdateTasks() {
+  bool shared = m_windowState.isOpen();
+  std::vector<Task> listed;
+
+  if (shared) {
+    std::vector<InWM::WindowStateEntry> entries;
+    m_windowState.read(entries);
+
+    m_activeWindow = None;
+    for (const InWM::WindowStateEntry& entry : entries) {
+      listed.push_back({ (Window)entry.m_id, entry.title(), None, entry.m_focused != 0 });
+      if (entry.m_focused) {
+        m_activeWindow = entry.m_id;
+      }
+    }
+  } else {
+    std::vector<Window> active = ReadWindows(m_root, m_netActiveWindow);
+    m_activeWindow = active.empty() ? None : active[0];
+
+    for (Window w : ReadWindows(m_root, m_netClientList)) {
+      listed.push_back({ w, "", None, w == m_activeWindow });
+    }
+  }
+
+  std::unordered_map<Window, size_t> known;
+  for (size_t i = 0; i < m_tasks.size(); i++) {
+    known[m_tasks[i].m_window] = i;
+  }
+
+  std::vector<Task> tasks;
+  tasks.reserve(listed.size());
+  for (Task& task : listed) {
+    auto it = known.find(task.m_window);
+    if (it != known.end()) {
+      task.m_icon = m_tasks[it->second].m_icon;
+      if (!shared) {
+        task.m_title = m_tasks[it->second].m_title;
+      }
+      tasks.push_back(task);
+      known.erase(it);
+      continue;
+    }
+
+    // Follow icon (and without inwm, title) changes of new windows
+    XSelectInput(m_dpy, task.m_window, PropertyChangeMask);
+    if (!shared) {
+      task.m_title = FetchTitle(task.m_window);
+    }
+    tasks.push_back(task);
+  }
+
+  // Whatever is left has gone away
+  for (const auto& gone : known) {
+    m_icons.Invalidate(gone.first);
+  }
+
+  SetTasks(std::move(tasks));
+}
+
+/*
+ * Focus changes only touch the buttons that lost and gained focus.
+ */
+void Bar::UpdateActiveWindow() {
+  std::vector<Window> active = ReadWindows(m_root, m_netActiveWindow);
+  Window w = active.empty() ? None : active[0];
+  if (w == m_activeWindow) return;
+
+  int previous = FindTask(m_activeWindow);
+  int current = FindTask(w);
+  m_activeWindow = w;
+
+  if (previous >= 0) {
+    m_tasks[previous].m_active = false;
+    MarkTaskDirty(previous);
+  }
+  if (current >= 0) {
+    m_tasks[current].m_active = true;
+    MarkTaskDirty(current);
   }
 }
 
+void Bar::SetTasks(std::vector<Task> tasks) {
+  std::vector<Task> previous = std::move(m_tasks);
+  m_tasks = std::move(tasks);
+
+  size_t count = std::min(std::max(previous.size(), m_tasks.size()), TaskSlots());
+  for (size_t slot = 0; slot < count; slot++) {
+    if (slot >= m_tasks.size() || slot >= previous.size() ||
+        !(previous[slot] == m_tasks[slot])) {
+      MarkTaskDirty(slot);
+    }
+  }
+}
+
+void Bar::MarkTaskDirty(size_t slot) {
+  m_dirtySlots.push_back(slot);
+}
+
+/*
+ * Paint one button into the back-buffer, or clear its slot if the task is gone.
+ */
+void Bar::PaintTask(size_t slot) {
+  int x = TASKS_X + slot * TASK_WIDTH;
+  int y = 2;
+  int width = TASK_WIDTH - 4;
+  int height = HEIGHT - 4;
+
+  GC face = Gc(0xC0C0C0);
+  if (slot >= m_tasks.size()) {
+    XFillRectangle(m_dpy, m_buffer, face, x, 1, TASK_WIDTH, HEIGHT - 2);
+    return;
+  }
+
+  // Button face, raised normally and pressed in for the focused window
+  Task& task = m_tasks[slot];
+  XFillRectangle(m_dpy, m_buffer, face, x, y, width, height);
+
+  GC topLeft = Gc(task.m_active ? 0x808080 : 0xFFFFFF);
+  XDrawLine(m_dpy, m_buffer, topLeft, x, y, x + width - 1, y);
+  XDrawLine(m_dpy, m_buffer, topLeft, x, y, x, y + height - 1);
+  GC bottomRight = Gc(task.m_active ? 0xFFFFFF : 0x808080);
+  XDrawLine(m_dpy, m_buffer, bottomRight, x, y + height - 1, x + width - 1, y + height - 1);
+  XDrawLine(m_dpy, m_buffer, bottomRight, x + width - 1, y, x + width - 1, y + height - 1);
+
+  // Ask every time, the pixmap may have been evicted since the last paint
+  task.m_icon = m_icons.Get(task.m_window);
+  if (task.m_icon != None) {
+    XCopyArea(m_dpy, task.m_icon, m_buffer, m_gc, 0, 0, ICON_SIZE, ICON_SIZE,
+              x + 4, (HEIGHT - ICON_SIZE) / 2);
+  }
+
+  // Title, cut to fit without splitting a UTF-8 sequence
+  int textX = x + ICON_SIZE + 8;
+  size_t length = m_font->fit(task.m_title.c_str(), task.m_title.size(), x + width - 4 - textX);
+  while (length > 0 && length < task.m_title.size() &&
+         (task.m_title[length] & 0xC0) == 0x80) {
+    length--;
+  }
+
+  XDrawString(m_dpy, m_buffer, Gc(0x000000), textX, 16, task.m_title.c_str(), length);
+}
+
+size_t Bar::TaskSlots() const {
+  int width = m_width - TASKS_X - CLOCK_WIDTH - StatusWidth();
+  return width > 0 ? width / TASK_WIDTH : 0;
+}
+
+int Bar::FindTask(Window w) const {
+  if (w == None) return -1;
+
+  for (size_t i = 0; i < m_tasks.size(); i++) {
+    if (m_tasks[i].m_window == w) return i;
+  }
+  return -1;
+}
+
+std::vector<Window> Bar::ReadWindows(Window w, Atom property) {
+  std::vector<Window> windows;
+  Atom type;
+  int format;
+  unsigned long count, after;
+  unsigned char* data = nullptr;
+
+  if (XGetWindowProperty(m_dpy, w, property, 0, 65536, False, XA_WINDOW,
+                         &type, &format, &count, &after, &data) == Success &&
+      data && format == 32) {
+    const Window* items = reinterpret_cast<const Window*>(data);
+    windows.assign(items, items + count);
+  }
+
+  if (data) XFree(data);
+  return windows;
+}
+
+std::string Bar::FetchTitle(Window w) {
+  Atom type;
+  int format;
+  unsigned long count, after;
+  unsigned char* data = nullptr;
+
+  // Prefer the UTF-8 name, fall back to WM_NAME
+  if (XGetWindowProperty(m_dpy, w, m_netWmName, 0, 256, False, m_utf8String,
+                         &type, &format, &count, &after, &data) == Success &&
+      data && format == 8 && count > 0) {
+    std::string title(reinterpret_cast<char*>(data), count);
+    XFree(data);
+    return title;
+  }
+  if (data) XFree(data);
+
+  char* name = nullptr;
+  std::string title;
+  if (XFetchName(m_dpy, w, &name) && name) {
+    title = name;
+    XFree(name);
+  }
+  return title;
+}
+
+int Bar::OnXError(Display* dpy, XErrorEvent* e) {
+  // Windows in the client list can be destroyed before we get to read them
+  if (e->error_code == BadWindow) return 0;
+
+  char text[256];
+  XGetErrorText(dpy, e->error_code, text, sizeof(text));
+  fprintf(stderr, "X error: %s (request %d)\n", text, e->request_code);
+  return 0;
+}
+
@@ -14,6 +14,15 @@
 #define INWM_BAR_HPP
 
 #include <X11/Xlib.h>
+#include <csignal>
+#include <memory>
+#include <string>
+#include <vector>
+#include "IconCache.hpp"
+#include "StatusModule.hpp"
+#include "../lib/Font.hpp"
+#include "../lib/GCCache.hpp"
+#include "../lib/WindowState.hpp"
 
 class Bar {
   public:
@@ -23,16 +32,115 @@ class Bar {
     void Run();
 
   private:
+    /*
+     * One button in the task switcher, as it is currently drawn.
+     */
+    struct Task {
+      Window m_window;
+      std::string m_title;
+      Pixmap m_icon;
+      bool m_active;
+
+      bool operator==(const Task& other) const {
+        return m_window == other.m_window && m_title == other.m_title &&
+               m_icon == other.m_icon && m_active == other.m_active;
+      }
+    };
+
+    static const int HEIGHT = 24;
+    static const int ICON_SIZE = 16;
+    static const int TASKS_X = 200;      // Task switcher starts after the menus
+    static const int TASK_WIDTH = 140;   // Every button gets the same slot
+    static const int CLOCK_WIDTH = 70;   // Kept free for the clock on the right
+
+    /*
+     * Parts of the back-buffer that need repainting before the next copy.
+     * Single task buttons are tracked in m_dirtySlots.
+     */
+    enum DirtyRegion {
+      DIRTY_FRAME = 1 << 0,  // Background, bevel and menus, implies the rest
+      DIRTY_TASKS = 1 << 1,
+      DIRTY_CLOCK = 1 << 2
+    };
+
+    /*
+     * Where the time goes, dumped to stderr on SIGUSR1.
+     */
+    struct Stats {
+      int64_t m_start;
+      uint64_t m_wakeups;
+      uint64_t m_xWakeups;
+      uint64_t m_workerWakeups;
+      uint64_t m_timerWakeups;
+      uint64_t m_events;
+      uint64_t m_completions;
+      uint64_t m_paints;
+    };
+
     Display* m_dpy;
     Window m_root;
     Window m_win;
+    int m_width;       // From ConfigureNotify
+    Pixmap m_buffer;   // Everything is painted here, then copied to m_win
+    GC m_gc;           // Copies the buffer; drawing uses InWM::GCCache
+    InWM::Font* m_font; // Drawn with and used to measure text
+    unsigned m_dirty;
+    std::vector<size_t> m_dirtySlots;
+    std::string m_clockText;
+    IconCache m_icons;  // Scaled application icons for the task switcher
+
+    Atom m_netClientList;
+    Atom m_netActiveWindow;
+    Atom m_netWmName;
+    Atom m_netWmIcon;
+    Atom m_utf8String;
+
+    std::vector<Task> m_tasks;  // What the switcher shows, slot by slot
+    Window m_activeWindow;
+    InWM::WindowStateReader m_windowState;  // Window list from inwm, if it runs
+
+    std::vector<std::unique_ptr<StatusModule>> m_modules;  // Left of the clock
+    Stats m_stats;
+    static volatile sig_atomic_t s_dumpStats;
 
     void CreateWindow();
     void DestroyWindow();
-    void Draw();
+    void CreateBuffer();
     void HandleEvent(XEvent* ev);
     void HandleExpose(XEvent* ev);
     void HandleButtonPress(XEvent* ev);
+    void HandleConfigureNotify(XEvent* ev);
+    void HandlePropertyNotify(XEvent* ev);
+
+    /* Painting */
+    void Paint();
+    GC Gc(unsigned long color) const;
+    void PaintFrame();
+    void PaintClock();
+    void UpdateClock();
+    int MsUntilNextMinute() const;
+
+    /* Status modules */
+    int SampleModules();
+    void PaintModule(size_t index);
+    int ModuleX(size_t index) const;
+    int StatusWidth() const;
+    void DumpStats();
+    static void OnSigUsr1(int signal);
+
+    /* Task switcher */
+    bool OpenWindowState();
+    void UpdateTasks();
+    void UpdateActiveWindow();
+    void SetTasks(std::vector<Task> tasks);
+    void PaintTask(size_t slot);
+    void MarkTaskDirty(size_t slot);
+    size_t TaskSlots() const;
+    int FindTask(Window w) const;
+    std::vector<Window> ReadWindows(Window w, Atom property);
+    std::string FetchTitle(Window w);
+
+    static int OnXError(Display* dpy, XErrorEvent* e);
 };
 
 #endif
\ No newline at end of file
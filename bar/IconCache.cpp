@@ -0,0 +1,285 @@
+#include "IconCache.hpp"
+#include "../lib/WorkerPool.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+extern "C" {
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+}
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Largest _NET_WM_ICON we are willing to read, in 32-bit items
+const long MAX_ICON_ITEMS = 1 << 20;
+
+/*
+ * Straight ARGB to premultiplied ARGB, four pixels at a time with SSE2.
+ */
+void Premultiply(const uint32_t* src, uint32_t* dst, size_t count) {
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi16(128);
+  const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+
+  for (; i + 4 <= count; i += 4) {
+    __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+    // Widen to 16 bits per channel, two pixels per register
+    __m128i lo = _mm_unpacklo_epi8(px, zero);
+    __m128i hi = _mm_unpackhi_epi8(px, zero);
+
+    // Broadcast each pixel's alpha over its four channels
+    __m128i alphaLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF);
+    __m128i alphaHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF);
+
+    // c * a / 255, rounded
+    lo = _mm_add_epi16(_mm_mullo_epi16(lo, alphaLo), round);
+    hi = _mm_add_epi16(_mm_mullo_epi16(hi, alphaHi), round);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+    // Narrow back and keep the original alpha
+    __m128i out = _mm_packus_epi16(lo, hi);
+    out = _mm_or_si128(_mm_andnot_si128(alphaMask, out), _mm_and_si128(alphaMask, px));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), out);
+  }
+#endif
+
+  for (; i < count; ++i) {
+    uint32_t px = src[i];
+    uint32_t a = px >> 24;
+    uint32_t out = px & 0xFF000000;
+    for (int shift = 0; shift < 24; shift += 8) {
+      uint32_t t = ((px >> shift) & 0xFF) * a + 128;
+      out |= (((t + (t >> 8)) >> 8) & 0xFF) << shift;
+    }
+    dst[i] = out;
+  }
+}
+
+/*
+ * Pick the image closest to `size` from a _NET_WM_ICON array: the smallest
+ * one that is at least `size`, or the largest one if they are all smaller.
+ * Returns the offset of its width field, or -1.
+ */
+long PickIcon(const std::vector<uint32_t>& data, int size) {
+  long best = -1;
+  uint32_t bestDim = 0;
+
+  for (size_t offset = 0; offset + 2 <= data.size(); ) {
+    uint32_t w = data[offset];
+    uint32_t h = data[offset + 1];
+    if (w == 0 || h == 0 || (uint64_t)w * h > data.size() - offset - 2) break;
+
+    uint32_t dim = std::max(w, h);
+    bool better = best < 0 ||
+      (dim >= (uint32_t)size && (bestDim < (uint32_t)size || dim < bestDim)) ||
+      (dim < (uint32_t)size && bestDim < (uint32_t)size && dim > bestDim);
+    if (better) {
+      best = offset;
+      bestDim = dim;
+    }
+
+    offset += 2 + (size_t)w * h;
+  }
+
+  return best;
+}
+
+uint64_t HashIcon(const uint32_t* data, size_t count) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < count; ++i) {
+    hash = (hash ^ data[i]) * 0x100000001b3ULL;
+  }
+  return hash ? hash : 1;
+}
+
+/*
+ * Scale a premultiplied image to size x size (box filter when shrinking,
+ * nearest pixel when growing) and composite it over `background`.
+ */
+std::vector<uint32_t> ScaleOver(const uint32_t* src, int w, int h, int size,
+                                unsigned long background) {
+  std::vector<uint32_t> out((size_t)size * size);
+
+  for (int y = 0; y < size; ++y) {
+    int y0 = y * h / size;
+    int y1 = std::max(y0 + 1, (y + 1) * h / size);
+
+    for (int x = 0; x < size; ++x) {
+      int x0 = x * w / size;
+      int x1 = std::max(x0 + 1, (x + 1) * w / size);
+
+      uint32_t sum[4] = {};
+      for (int sy = y0; sy < y1; ++sy) {
+        for (int sx = x0; sx < x1; ++sx) {
+          uint32_t px = src[(size_t)sy * w + sx];
+          for (int c = 0; c < 4; ++c) sum[c] += (px >> (c * 8)) & 0xFF;
+        }
+      }
+
+      uint32_t n = (y1 - y0) * (x1 - x0);
+      uint32_t alpha = sum[3] / n;
+      uint32_t pixel = 0;
+      for (int c = 0; c < 3; ++c) {
+        uint32_t bg = (background >> (c * 8)) & 0xFF;
+        uint32_t value = sum[c] / n + bg * (255 - alpha) / 255;
+        pixel |= std::min<uint32_t>(value, 255) << (c * 8);
+      }
+      out[(size_t)y * size + x] = pixel;
+    }
+  }
+
+  return out;
+}
+
+}
+
+IconCache::IconCache(Display* dpy, int size, unsigned long background, size_t capacity)
+: m_dpy(dpy),
+  m_size(size),
+  m_background(background),
+  m_capacity(capacity),
+  m_generation(0) {
+  m_iconAtom = XInternAtom(m_dpy, "_NET_WM_ICON", False);
+}
+
+IconCache::~IconCache() {
+  for (const Entry& entry : m_lru) {
+    XFreePixmap(m_dpy, entry.m_pixmap);
+  }
+}
+
+Pixmap IconCache::Get(Window w) {
+  auto known = m_windowHash.find(w);
+  if (known != m_windowHash.end()) {
+    if (known->second == 0) return None;
+
+    auto cached = m_byHash.find(known->second);
+    if (cached != m_byHash.end()) {
+      m_lru.splice(m_lru.begin(), m_lru, cached->second);
+      return cached->second->m_pixmap;
+    }
+  }
+
+  // Evicted or never seen, convert it again
+  if (!m_pending.count(w)) {
+    Request(w);
+  }
+  return None;
+}
+
+void IconCache::Invalidate(Window w) {
+  m_windowHash.erase(w);
+  m_pending.erase(w);
+}
+
+void IconCache::Request(Window w) {
+  Atom type;
+  int format;
+  unsigned long count, after;
+  unsigned char* data = nullptr;
+
+  if (XGetWindowProperty(m_dpy, w, m_iconAtom, 0, MAX_ICON_ITEMS, False, XA_CARDINAL,
+                         &type, &format, &count, &after, &data) != Success ||
+      !data || format != 32 || count < 3) {
+    if (data) XFree(data);
+    m_windowHash[w] = 0;
+    return;
+  }
+
+  // Format 32 properties come back as longs
+  std::vector<uint32_t> icon(count);
+  const unsigned long* items = reinterpret_cast<const unsigned long*>(data);
+  for (unsigned long i = 0; i < count; ++i) {
+    icon[i] = items[i];
+  }
+  XFree(data);
+
+  unsigned generation = ++m_generation;
+  m_pending[w] = generation;
+
+  int size = m_size;
+  unsigned long background = m_background;
+  InWM::WorkerPool::shared().submit([this, w, generation, size, background,
+                                     icon = std::move(icon)]() -> InWM::WorkerPool::Completion {
+    long offset = PickIcon(icon, size);
+    if (offset < 0) {
+      return [this, w, generation]() { Store(w, generation, 0, {}); };
+    }
+
+    int width = icon[offset];
+    int height = icon[offset + 1];
+    const uint32_t* argb = icon.data() + offset + 2;
+    size_t pixels = (size_t)width * height;
+
+    uint64_t hash = HashIcon(icon.data() + offset, pixels + 2);
+    std::vector<uint32_t> premultiplied(pixels);
+    Premultiply(argb, premultiplied.data(), pixels);
+    std::vector<uint32_t> scaled = ScaleOver(premultiplied.data(), width, height,
+                                             size, background);
+
+    return [this, w, generation, hash, scaled = std::move(scaled)]() mutable {
+      Store(w, generation, hash, std::move(scaled));
+    };
+  });
+}
+
+void IconCache::Store(Window w, unsigned generation, uint64_t hash, std::vector<uint32_t> pixels) {
+  // Invalidated or re-requested while we were converting
+  auto pending = m_pending.find(w);
+  if (pending == m_pending.end() || pending->second != generation) return;
+  m_pending.erase(pending);
+
+  m_windowHash[w] = hash;
+  if (hash == 0) return;
+
+  // Another window with the same icon may have beaten us to it
+  if (!m_byHash.count(hash)) {
+    Pixmap pixmap = Upload(pixels);
+    if (pixmap == None) {
+      m_windowHash[w] = 0;
+      return;
+    }
+
+    m_lru.push_front({ hash, pixmap });
+    m_byHash[hash] = m_lru.begin();
+
+    while (m_lru.size() > m_capacity) {
+      XFreePixmap(m_dpy, m_lru.back().m_pixmap);
+      m_byHash.erase(m_lru.back().m_hash);
+      m_lru.pop_back();
+    }
+  }
+
+  if (m_onReady) {
+    m_onReady(w);
+  }
+}
+
+Pixmap IconCache::Upload(const std::vector<uint32_t>& pixels) {
+  int screen = DefaultScreen(m_dpy);
+  int depth = DefaultDepth(m_dpy, screen);
+  Visual* visual = DefaultVisual(m_dpy, screen);
+  if (depth < 24 || visual->red_mask != 0xFF0000 || visual->blue_mask != 0x0000FF) {
+    return None;
+  }
+
+  Window root = RootWindow(m_dpy, screen);
+  Pixmap pixmap = XCreatePixmap(m_dpy, root, m_size, m_size, depth);
+  XImage* image = XCreateImage(m_dpy, visual, depth, ZPixmap, 0,
+                               (char*)pixels.data(), m_size, m_size, 32, 0);
+  GC gc = DefaultGC(m_dpy, screen);
+  XPutImage(m_dpy, pixmap, gc, image, 0, 0, 0, 0, m_size, m_size);
+
+  // The pixel buffer belongs to the vector
+  image->data = nullptr;
+  XDestroyImage(image);
+  return pixmap;
+}
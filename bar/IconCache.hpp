@@ -0,0 +1,69 @@
+/*
+ * InWM Bar - Application icon cache
+ *
+ * Reads _NET_WM_ICON, picks the source size closest to what the bar needs,
+ * premultiplies and scales it on the worker pool and keeps the result as a
+ * ready-to-blit pixmap. Pixmaps are keyed by a hash of the icon data, so
+ * windows of the same application share one, and the least recently used
+ * ones are dropped when the cache is full.
+ *
+ * (c) 2025 InWM Project
+ */
+
+#ifndef INWM_ICONCACHE_HPP
+#define INWM_ICONCACHE_HPP
+
+#include <X11/Xlib.h>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+class IconCache {
+  public:
+    IconCache(Display* dpy, int size, unsigned long background, size_t capacity = 128);
+    ~IconCache();
+
+    /*
+     * Icon for `w` as a size x size pixmap, already composited over the
+     * background colour. Returns None while the icon is being converted (the
+     * ready callback fires once it is available) or if the window has none.
+     */
+    Pixmap Get(Window w);
+
+    /*
+     * The window's _NET_WM_ICON changed, or the window went away.
+     */
+    void Invalidate(Window w);
+
+    void SetReadyCallback(std::function<void(Window)> callback) { m_onReady = callback; }
+    int Size() const { return m_size; }
+
+  private:
+    struct Entry {
+      uint64_t m_hash;
+      Pixmap m_pixmap;
+    };
+
+    void Request(Window w);
+    void Store(Window w, unsigned generation, uint64_t hash, std::vector<uint32_t> pixels);
+    Pixmap Upload(const std::vector<uint32_t>& pixels);
+
+    Display* m_dpy;
+    int m_size;
+    unsigned long m_background;
+    size_t m_capacity;
+    Atom m_iconAtom;
+    std::function<void(Window)> m_onReady;
+
+    std::list<Entry> m_lru;  // Most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_byHash;
+    std::unordered_map<Window, uint64_t> m_windowHash;  // 0 means no icon
+
+    // Conversions in flight; a newer generation supersedes older results
+    std::unordered_map<Window, unsigned> m_pending;
+    unsigned m_generation;
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include "StatusModule.hpp"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+
+namespace {
+
+/*
+ * First line of a small sysfs/procfs file, without the newline.
+ */
+std::string ReadLine(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file) return "";
+
+  char line[256] = "";
+  if (!fgets(line, sizeof(line), file)) line[0] = '\0';
+  fclose(file);
+
+  line[strcspn(line, "\n")] = '\0';
+  return line;
+}
+
+/*
+ * Bytes per second as at most four characters, e.g. "12K" or "1.5M".
+ */
+std::string FormatRate(double rate) {
+  const char* units = "BKMGT";
+  while (rate >= 1000 && units[1]) {
+    rate /= 1024;
+    units++;
+  }
+
+  char text[16];
+  if (rate < 10 && *units != 'B') {
+    snprintf(text, sizeof(text), "%.1f%c", rate, *units);
+  } else {
+    snprintf(text, sizeof(text), "%d%c", (int)rate, *units);
+  }
+  return text;
+}
+
+}
+
+int64_t MonotonicMs() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+StatusModule::StatusModule(const char* name, int intervalMs, int width)
+: m_busy(false),
+  m_dirty(true),
+  m_nextSample(0),
+  m_samples(0),
+  m_changes(0),
+  m_name(name),
+  m_intervalMs(intervalMs),
+  m_width(width) {}
+
+CpuModule::CpuModule()
+: StatusModule("cpu", 2000, 76), m_lastBusy(0), m_lastTotal(0) {}
+
+std::string CpuModule::Sample() {
+  FILE* file = fopen("/proc/stat", "r");
+  if (!file) return "CPU ?";
+
+  unsigned long long user = 0, nice = 0, system = 0, idle = 0;
+  unsigned long long iowait = 0, irq = 0, softirq = 0, steal = 0;
+  int fields = fscanf(file, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+                      &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal);
+  fclose(file);
+  if (fields < 4) return "CPU ?";
+
+  uint64_t total = user + nice + system + idle + iowait + irq + softirq + steal;
+  uint64_t busy = total - idle - iowait;
+
+  // The first sample is the average since boot
+  uint64_t totalDelta = total - m_lastTotal;
+  uint64_t busyDelta = busy - m_lastBusy;
+  m_lastTotal = total;
+  m_lastBusy = busy;
+
+  char text[16];
+  snprintf(text, sizeof(text), "CPU %d%%",
+           totalDelta ? (int)(busyDelta * 100 / totalDelta) : 0);
+  return text;
+}
+
+MemoryModule::MemoryModule()
+: StatusModule("memory", 5000, 76) {}
+
+std::string MemoryModule::Sample() {
+  FILE* file = fopen("/proc/meminfo", "r");
+  if (!file) return "MEM ?";
+
+  unsigned long long total = 0, available = 0;
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    sscanf(line, "MemTotal: %llu", &total);
+    sscanf(line, "MemAvailable: %llu", &available);
+  }
+  fclose(file);
+  if (total == 0) return "MEM ?";
+
+  char text[16];
+  snprintf(text, sizeof(text), "MEM %d%%", (int)((total - available) * 100 / total));
+  return text;
+}
+
+NetworkModule::NetworkModule()
+: StatusModule("network", 2000, 80), m_lastRx(0), m_lastTx(0), m_lastTime(0) {}
+
+std::string NetworkModule::Sample() {
+  FILE* file = fopen("/proc/net/dev", "r");
+  if (!file) return "";
+
+  uint64_t rx = 0, tx = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), file)) {
+    // "  eth0: rx_bytes rx_packets ... (8 fields) tx_bytes ..."
+    char* colon = strchr(line, ':');
+    if (!colon) continue;
+
+    *colon = '\0';
+    char name[64];
+    if (sscanf(line, "%63s", name) != 1 || strcmp(name, "lo") == 0) continue;
+
+    unsigned long long fields[9];
+    if (sscanf(colon + 1, "%llu %llu %llu %llu %llu %llu %llu %llu %llu",
+               &fields[0], &fields[1], &fields[2], &fields[3], &fields[4],
+               &fields[5], &fields[6], &fields[7], &fields[8]) == 9) {
+      rx += fields[0];
+      tx += fields[8];
+    }
+  }
+  fclose(file);
+
+  int64_t now = MonotonicMs();
+  int64_t elapsed = now - m_lastTime;
+  bool first = m_lastTime == 0;
+  double rxRate = first ? 0 : (rx - m_lastRx) * 1000.0 / elapsed;
+  double txRate = first ? 0 : (tx - m_lastTx) * 1000.0 / elapsed;
+  m_lastRx = rx;
+  m_lastTx = tx;
+  m_lastTime = now;
+
+  return FormatRate(rxRate) + "/" + FormatRate(txRate);
+}
+
+BatteryModule::BatteryModule()
+: StatusModule("battery", 30000, 76) {
+  DIR* dir = opendir("/sys/class/power_supply");
+  if (!dir) return;
+
+  while (dirent* entry = readdir(dir)) {
+    std::string path = std::string("/sys/class/power_supply/") + entry->d_name;
+    if (entry->d_name[0] != '.' && ReadLine(path + "/type") == "Battery") {
+      m_path = path;
+      break;
+    }
+  }
+  closedir(dir);
+}
+
+std::string BatteryModule::Sample() {
+  std::string capacity = ReadLine(m_path + "/capacity");
+  if (capacity.empty()) return "BAT ?";
+
+  // A trailing + while on the charger
+  bool charging = ReadLine(m_path + "/status") == "Charging";
+  return "BAT " + capacity + "%" + (charging ? "+" : "");
+}
+
+std::vector<std::unique_ptr<StatusModule>> CreateStatusModules() {
+  std::vector<std::unique_ptr<StatusModule>> modules;
+  modules.emplace_back(new CpuModule());
+  modules.emplace_back(new MemoryModule());
+  modules.emplace_back(new NetworkModule());
+  modules.emplace_back(new BatteryModule());
+
+  // Drop what this machine does not have, e.g. a battery on a desktop
+  for (auto it = modules.begin(); it != modules.end(); ) {
+    it = (*it)->Available() ? it + 1 : modules.erase(it);
+  }
+  return modules;
+}
@@ -0,0 +1,113 @@
+/*
+ * InWM Bar - System tray status modules
+ *
+ * Each module samples /proc or /sys on the worker pool at its own interval
+ * and the bar repaints its segment only when the text it produces changes.
+ *
+ * (c) 2025 InWM Project
+ */
+
+#ifndef INWM_STATUSMODULE_HPP
+#define INWM_STATUSMODULE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class StatusModule {
+  public:
+    StatusModule(const char* name, int intervalMs, int width);
+    virtual ~StatusModule() {}
+
+    /*
+     * Read the current value and format it for the bar. Runs on a worker,
+     * never concurrently with itself, so state kept between samples (e.g.
+     * previous counters) needs no locking.
+     */
+    virtual std::string Sample() = 0;
+
+    /*
+     * Whether there is anything to show on this machine at all.
+     */
+    virtual bool Available() const { return true; }
+
+    const char* Name() const { return m_name; }
+    int IntervalMs() const { return m_intervalMs; }
+    int Width() const { return m_width; }
+
+    /* Owned by the bar, only touched on the X thread */
+    std::string m_text;      // What is currently drawn
+    bool m_busy;             // A sample is in flight
+    bool m_dirty;            // Segment needs repainting
+    int64_t m_nextSample;    // Monotonic deadline in ms
+    uint64_t m_samples;
+    uint64_t m_changes;
+
+  private:
+    const char* m_name;
+    int m_intervalMs;
+    int m_width;
+};
+
+/*
+ * CPU busy percentage from /proc/stat.
+ */
+class CpuModule : public StatusModule {
+  public:
+    CpuModule();
+    std::string Sample() override;
+
+  private:
+    uint64_t m_lastBusy;
+    uint64_t m_lastTotal;
+};
+
+/*
+ * Used memory percentage from /proc/meminfo (MemTotal - MemAvailable).
+ */
+class MemoryModule : public StatusModule {
+  public:
+    MemoryModule();
+    std::string Sample() override;
+};
+
+/*
+ * Receive and transmit rates over all interfaces but loopback, from
+ * /proc/net/dev.
+ */
+class NetworkModule : public StatusModule {
+  public:
+    NetworkModule();
+    std::string Sample() override;
+
+  private:
+    uint64_t m_lastRx;
+    uint64_t m_lastTx;
+    int64_t m_lastTime;
+};
+
+/*
+ * Charge of the first battery under /sys/class/power_supply.
+ */
+class BatteryModule : public StatusModule {
+  public:
+    BatteryModule();
+    std::string Sample() override;
+    bool Available() const override { return !m_path.empty(); }
+
+  private:
+    std::string m_path;
+};
+
+/*
+ * Milliseconds on the monotonic clock.
+ */
+int64_t MonotonicMs();
+
+/*
+ * The modules available on this machine, in bar order.
+ */
+std::vector<std::unique_ptr<StatusModule>> CreateStatusModules();
+
+#endif
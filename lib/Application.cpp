@@ -1,6 +1,10 @@
 #include "Application.hpp"
+#include "GCCache.hpp"
 #include "Window.hpp"
+#include "WorkerPool.hpp"
+#include <algorithm>
 #include <cstdio>
+#include <poll.h>
 
 namespace InWM {
 
@@ -11,37 +15,79 @@ std::unique_ptr<Application> Application::create() {
     return nullptr;
   }
   
-  return std::unique_ptr<Application>(new Application(display));
+  int screen = DefaultScreen(display);
+  return std::unique_ptr<Application>(new Application(
+    display, DisplayWidth(display, screen), DisplayHeight(display, screen)));
 }
 
-Application::Application(Display* display) 
-: m_display(display), m_root(DefaultRootWindow(display)) {
-  int screen = DefaultScreen(m_display);
-  m_gc = DefaultGC(m_display, screen);
+std::unique_ptr<Application> Application::createHeadless(int screenWidth, int screenHeight) {
+  return std::unique_ptr<Application>(new Application(nullptr, screenWidth, screenHeight));
+}
+
+Application::Application(Display* display, int screenWidth, int screenHeight) 
+: m_display(display), m_root(None), m_gc(nullptr),
+  m_screenWidth(screenWidth), m_screenHeight(screenHeight) {
+  if (m_display) {
+    m_root = DefaultRootWindow(m_display);
+    m_gc = DefaultGC(m_display, DefaultScreen(m_display));
+  }
+  m_font = Font::get(m_display);
 }
 
 Application::~Application() {
+  // Windows free their X resources, so they have to go first
+  m_windows.clear();
   if (m_display) {
+    GCCache::release(m_display);
+    Font::release(m_display);
     XCloseDisplay(m_display);
+  } else {
+    Font::release(nullptr);
   }
 }
 
 void Application::run() {
+  if (!m_display) return;
+  
   XEvent event;
+  WorkerPool& pool = WorkerPool::shared();
   
   while (m_running) {
-    XNextEvent(m_display, &event);
-    handleX11Event(event);
+    while (m_running && XPending(m_display)) {
+      XNextEvent(m_display, &event);
+      handleX11Event(event);
+    }
+    
+    // Apply finished background work in one batch per iteration
+    pool.runCompletions();
+    
+    // Then paint everything the events and completions invalidated
+    int timeout = paintScheduledWindows();
+    
+    // XPending also flushes what we just painted
+    if (!m_running || XPending(m_display)) continue;
+    
+    pollfd fds[2] = {
+      { ConnectionNumber(m_display), POLLIN, 0 },
+      { pool.completionFd(), POLLIN, 0 }
+    };
+    poll(fds, 2, timeout);
   }
 }
 
 std::shared_ptr<Window> Application::createWindow(const std::string& title, int width, int height) {
   auto window = std::make_shared<Window>(this, title, width, height);
   m_windows.push_back(window);
+  if (window->getXWindow() != None) {
+    m_windowsByXid[window->getXWindow()] = window.get();
+  }
   return window;
 }
 
 void Application::closeWindow(Window* window) {
+  if (window->getXWindow() != None) {
+    m_windowsByXid.erase(window->getXWindow());
+  }
   m_windows.erase(
     std::remove_if(m_windows.begin(), m_windows.end(),
                   [window](const auto& ptr) { return ptr.get() == window; }),
@@ -49,12 +95,42 @@ void Application::closeWindow(Window* window) {
   );
 }
 
+void Application::schedulePaint(Window* window) {
+  if (std::find(m_paintQueue.begin(), m_paintQueue.end(), window) == m_paintQueue.end()) {
+    m_paintQueue.push_back(window);
+  }
+}
+
+void Application::cancelPaint(Window* window) {
+  m_paintQueue.erase(std::remove(m_paintQueue.begin(), m_paintQueue.end(), window),
+                     m_paintQueue.end());
+}
+
+int Application::paintScheduledWindows() {
+  if (m_paintQueue.empty()) return -1;
+  
+  auto now = std::chrono::steady_clock::now();
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_lastPaint);
+  if (elapsed.count() < FRAME_INTERVAL_MS) {
+    return FRAME_INTERVAL_MS - elapsed.count();
+  }
+  m_lastPaint = now;
+  
+  // Painting may invalidate again; that waits for the next frame
+  std::vector<Window*> windows;
+  windows.swap(m_paintQueue);
+  for (Window* window : windows) {
+    window->paint();
+  }
+  return m_paintQueue.empty() ? -1 : FRAME_INTERVAL_MS;
+}
+
 void Application::handleX11Event(const XEvent& xevent) {
-  // Find the window that should handle this event
-  for (auto& window : m_windows) {
-    if (window->handleX11Event(xevent)) {
-      break; // Event was handled
-    }
+  // xany.window is the window the event was reported on for every type we
+  // select, so one lookup finds the owner
+  auto it = m_windowsByXid.find(xevent.xany.window);
+  if (it == m_windowsByXid.end() || !it->second->handleX11Event(xevent)) {
+    m_unclaimedEvents++;
   }
 }
 
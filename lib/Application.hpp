@@ -2,7 +2,11 @@
 #define INWM_APPLICATION_HPP
 
 #include "GUI.hpp"
+#include "Font.hpp"
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
 
 namespace InWM {
 
@@ -11,9 +15,14 @@ class Window;
 class Application {
 public:
     static std::unique_ptr<Application> create();
+    
+    // No display connection: windows draw into client memory (see
+    // Window::getRaster) with the built-in font, and are painted by calling
+    // Window::paint(). For rendering tests and benchmarks without X.
+    static std::unique_ptr<Application> createHeadless(int screenWidth, int screenHeight);
     ~Application();
 
-    // Core methods
+    // Core methods. run() needs a display and returns at once without one.
     void run();
     void quit() { m_running = false; }
     
@@ -25,18 +34,46 @@ public:
     Display* getDisplay() const { return m_display; }
     ::Window getRoot() const { return m_root; }
     GC getDefaultGC() const { return m_gc; }
+    bool isHeadless() const { return m_display == nullptr; }
+    int getScreenWidth() const { return m_screenWidth; }
+    int getScreenHeight() const { return m_screenHeight; }
+    
+    // Font widgets draw and measure text with
+    Font* getFont() const { return m_font; }
     
     // Event handling
     void handleX11Event(const XEvent& xevent);
+    
+    // Events for windows we do not know (e.g. already closed) or that the
+    // window did not handle
+    uint64_t getUnclaimedEventCount() const { return m_unclaimedEvents; }
+    
+    // Repaint scheduling. Windows call this when something in them was
+    // invalidated; each one is painted at most once per loop iteration and
+    // no more often than FRAME_INTERVAL_MS.
+    void schedulePaint(Window* window);
+    void cancelPaint(Window* window);
+    
+    static const int FRAME_INTERVAL_MS = 16;
 
 private:
-    Application(Display* display);
+    Application(Display* display, int screenWidth, int screenHeight);
+    
+    // Paint scheduled windows if a frame is due. Returns the poll timeout
+    // until the next one, or -1 if nothing is waiting.
+    int paintScheduledWindows();
     
     Display* m_display;
     ::Window m_root;
     GC m_gc;
+    Font* m_font;
+    int m_screenWidth, m_screenHeight;
     bool m_running = true;
     std::vector<std::shared_ptr<Window>> m_windows;
+    std::unordered_map<::Window, Window*> m_windowsByXid;  // Event routing
+    uint64_t m_unclaimedEvents = 0;
+    std::vector<Window*> m_paintQueue;
+    std::chrono::steady_clock::time_point m_lastPaint;
 };
 
 } // namespace InWM
@@ -1,5 +1,6 @@
 #include "Button.hpp"
 #include "Application.hpp"
+#include "DrawContext.hpp"
 
 namespace InWM {
 
@@ -9,16 +10,16 @@ Button::Button(Application* app, Widget* parent)
 Button::Button(Application* app, const std::string& text, Widget* parent)
 : Widget(app, parent), m_text(text) { }
 
-void Button::draw(Drawable drawable, GC gc) {
+void Button::draw(DrawContext& dc) {
   if (!isVisible()) return;
   
   const Rect& bounds = getBounds();
   
   // Draw 3D button
-  drawRect3D(drawable, gc, bounds, !m_pressed);
+  drawRect3D(dc, bounds, !m_pressed);
   
   // Calculate text position (centered)
-  int textWidth = m_text.length() * 8; // Approximate character width
+  int textWidth = m_app->getFont()->textWidth(m_text);
   int textX = bounds.x + (bounds.width - textWidth) / 2;
   int textY = bounds.y + bounds.height / 2 + 4; // Slight offset for centering
   
@@ -29,13 +30,12 @@ void Button::draw(Drawable drawable, GC gc) {
   }
   
   // Draw text
-  XSetForeground(m_app->getDisplay(), gc, isEnabled() ? Colors::BLACK : Colors::GRAY_DARK);
-  XDrawString(m_app->getDisplay(), drawable, gc, textX, textY, m_text.c_str(), m_text.length());
+  dc.drawText(isEnabled() ? Colors::BLACK : Colors::GRAY_DARK, textX, textY, m_text);
   
   // Draw children
   for (auto& child : getChildren()) {
     if (child->isVisible()) {
-      child->draw(drawable, gc);
+      child->draw(dc);
     }
   }
 }
@@ -47,20 +47,21 @@ void Button::handleEvent(const Event& event) {
     case CLICK:
       if (event.button > 0) { // Button press
         m_pressed = true;
+        invalidate();
       } else { // Button release
+        // The release reaches CLICK listeners once this returns;
+        // triggering it again from here would recurse forever
         m_pressed = false;
-        // Trigger click callback if released over button
-        if (getBounds().contains(event.x, event.y)) {
-          Event clickEvent = event;
-          clickEvent.type = CLICK;
-          clickEvent.target = this;
-          triggerEvent(clickEvent);
-        }
+        invalidate();
       }
       break;
         
-    case HOVER:
-      m_hover = getBounds().contains(event.x, event.y);
+    case ENTER:
+    case LEAVE:
+      m_hover = event.type == ENTER;
+      break;
+
+    default:
       break;
   }
 }
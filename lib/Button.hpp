@@ -11,14 +11,14 @@ class Button : public Widget {
     Button(Application* app, const std::string& text, Widget* parent = nullptr);
     
     // Widget interface
-    void draw(Drawable drawable, GC gc) override;
+    void draw(DrawContext& dc) override;
     void handleEvent(const Event& event) override;
     
     // Button specific
-    void setText(const std::string& text) { m_text = text; }
+    void setText(const std::string& text) { m_text = text; invalidate(); }
     const std::string& getText() const { return m_text; }
     
-    void setPressed(bool pressed) { m_pressed = pressed; }
+    void setPressed(bool pressed) { m_pressed = pressed; invalidate(); }
     bool isPressed() const { return m_pressed; }
 
   private:
@@ -0,0 +1,142 @@
+#include "DrawContext.hpp"
+#include "Font.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace InWM {
+
+void XDrawContext::begin(Drawable drawable, GC gc) {
+  flush();
+  m_drawable = drawable;
+  m_gc = gc;
+}
+
+XDrawContext::Group& XDrawContext::groupFor(Kind kind, unsigned long color, const Rect& rect) {
+  size_t index = m_groupCount;
+  for (size_t i = 0; i < m_groupCount; ++i) {
+    if (m_groups[i].kind == kind && m_groups[i].color == color) {
+      index = i;
+      break;
+    }
+  }
+
+  // Later kinds are drawn after us, and so are later groups of our kind
+  for (size_t i = 0; i < m_groupCount; ++i) {
+    const Group& other = m_groups[i];
+    bool drawnAfter = other.kind > kind || (other.kind == kind && i > index);
+    if (drawnAfter && other.bounds.intersects(rect)) {
+      flush();
+      index = 0;
+      break;
+    }
+  }
+
+  if (index == m_groupCount) {
+    if (m_groupCount == m_groups.size()) {
+      m_groups.emplace_back();
+    }
+    Group& group = m_groups[m_groupCount++];
+    group.kind = kind;
+    group.color = color;
+    group.bounds = Rect();
+  }
+
+  Group& group = m_groups[index];
+  group.bounds = group.bounds.united(rect);
+  return group;
+}
+
+void XDrawContext::fillRect(unsigned long color, const Rect& rect) {
+  if (rect.isEmpty()) return;
+  groupFor(FILLS, color, rect).rects.push_back({ (short)rect.x, (short)rect.y,
+                                                 (unsigned short)rect.width,
+                                                 (unsigned short)rect.height });
+}
+
+void XDrawContext::drawLine(unsigned long color, int x1, int y1, int x2, int y2) {
+  Rect bounds(std::min(x1, x2), std::min(y1, y2),
+              std::abs(x2 - x1) + 1, std::abs(y2 - y1) + 1);
+  groupFor(LINES, color, bounds).segments.push_back({ (short)x1, (short)y1,
+                                                      (short)x2, (short)y2 });
+}
+
+void XDrawContext::drawRect(unsigned long color, const Rect& rect) {
+  if (rect.isEmpty()) return;
+  int right = rect.x + rect.width - 1;
+  int bottom = rect.y + rect.height - 1;
+  Group& group = groupFor(LINES, color, rect);
+  group.segments.push_back({ (short)rect.x, (short)rect.y, (short)right, (short)rect.y });
+  group.segments.push_back({ (short)rect.x, (short)bottom, (short)right, (short)bottom });
+  group.segments.push_back({ (short)rect.x, (short)rect.y, (short)rect.x, (short)bottom });
+  group.segments.push_back({ (short)right, (short)rect.y, (short)right, (short)bottom });
+}
+
+void XDrawContext::drawText(unsigned long color, int x, int y, const char* text, size_t length) {
+  if (length == 0) return;
+  int width = m_font->textWidth(text, length);
+  Rect bounds(x, y - m_font->getAscent(), width, m_font->getHeight());
+  Group& group = groupFor(TEXT, color, bounds);
+  group.text.push_back({ x, y, width, m_text.size(), length });
+  m_text.append(text, length);
+}
+
+void XDrawContext::flush() {
+  for (int kind = FILLS; kind < KINDS; ++kind) {
+    for (size_t i = 0; i < m_groupCount; ++i) {
+      Group& group = m_groups[i];
+      if (group.kind != kind) continue;
+
+      XSetForeground(m_dpy, m_gc, group.color);
+      switch (group.kind) {
+        case FILLS:
+          XFillRectangles(m_dpy, m_drawable, m_gc, group.rects.data(), group.rects.size());
+          break;
+        case LINES:
+          XDrawSegments(m_dpy, m_drawable, m_gc, group.segments.data(), group.segments.size());
+          break;
+        default:
+          flushText(group);
+          break;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < m_groupCount; ++i) {
+    m_groups[i].rects.clear();
+    m_groups[i].segments.clear();
+    m_groups[i].text.clear();
+  }
+  m_groupCount = 0;
+  m_text.clear();
+}
+
+void XDrawContext::flushText(Group& group) {
+  // Strings of one color don't cover each other, so they can go out in any
+  // order: one XDrawText per baseline, left to right
+  std::sort(group.text.begin(), group.text.end(), [](const TextItem& a, const TextItem& b) {
+    return a.y != b.y ? a.y < b.y : a.x < b.x;
+  });
+
+  size_t start = 0;
+  while (start < group.text.size()) {
+    size_t end = start;
+    int penX = group.text[start].x;
+    m_textItems.clear();
+    while (end < group.text.size() && group.text[end].y == group.text[start].y) {
+      const TextItem& item = group.text[end];
+      XTextItem xitem;
+      xitem.chars = &m_text[item.offset];
+      xitem.nchars = item.length;
+      xitem.delta = item.x - penX;    // Xlib splits deltas the protocol can't take
+      xitem.font = None;
+      m_textItems.push_back(xitem);
+      penX = item.x + item.width;
+      ++end;
+    }
+    XDrawText(m_dpy, m_drawable, m_gc, group.text[start].x, group.text[start].y,
+              m_textItems.data(), m_textItems.size());
+    start = end;
+  }
+}
+
+} // namespace InWM
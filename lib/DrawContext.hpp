@@ -0,0 +1,114 @@
+#ifndef INWM_DRAWCONTEXT_HPP
+#define INWM_DRAWCONTEXT_HPP
+
+#include "GUI.hpp"
+#include <string>
+#include <vector>
+
+namespace InWM {
+
+class Font;
+
+// What widgets draw through. The window picks the implementation: X
+// requests batched by color (XDrawContext, the default), or pixels drawn in
+// client memory (RasterDrawContext). Colors are 0xRRGGBB.
+class DrawContext {
+  public:
+    DrawContext(Display* dpy, Font* font) : m_dpy(dpy), m_font(font) {}
+    virtual ~DrawContext() = default;
+
+    DrawContext(const DrawContext&) = delete;
+    DrawContext& operator=(const DrawContext&) = delete;
+
+    virtual void fillRect(unsigned long color, const Rect& rect) = 0;
+    virtual void drawLine(unsigned long color, int x1, int y1, int x2, int y2) = 0;
+
+    // One pixel wide, along the inside edge of `rect`
+    virtual void drawRect(unsigned long color, const Rect& rect) = 0;
+
+    // `y` is the baseline, as for XDrawString
+    virtual void drawText(unsigned long color, int x, int y, const char* text, size_t length) = 0;
+    void drawText(unsigned long color, int x, int y, const std::string& text) {
+      drawText(color, x, y, text.data(), text.size());
+    }
+
+    // Send whatever is still queued
+    virtual void flush() {}
+
+    // For drawing with Xlib directly; call flush() first so it ends up on
+    // top of what is queued. There is no drawable (None) when the window
+    // renders client-side.
+    Display* getDisplay() const { return m_dpy; }
+    Font* getFont() const { return m_font; }
+    virtual Drawable getDrawable() const { return None; }
+    virtual GC getGC() const { return nullptr; }
+
+  protected:
+    Display* m_dpy;
+    Font* m_font;
+};
+
+// Lines, rectangles and text are queued by color and sent when the paint is
+// flushed: one XSetForeground plus one XFillRectangles, XDrawSegments or
+// XDrawText (per baseline) for each color, instead of a foreground change
+// and a request for every primitive.
+//
+// Queued primitives go out fills first, then lines, then text. Whenever that
+// would put a primitive under something queued before it that it overlaps,
+// the queue is flushed first, so the result is the same as drawing in call
+// order.
+class XDrawContext : public DrawContext {
+  public:
+    XDrawContext(Display* dpy, Font* font) : DrawContext(dpy, font) {}
+
+    // Send the following primitives to `drawable`. The GC's font should be
+    // `font`, which text is measured with.
+    void begin(Drawable drawable, GC gc);
+    void flush() override;
+
+    void fillRect(unsigned long color, const Rect& rect) override;
+    void drawLine(unsigned long color, int x1, int y1, int x2, int y2) override;
+    void drawRect(unsigned long color, const Rect& rect) override;
+    using DrawContext::drawText;
+    void drawText(unsigned long color, int x, int y, const char* text, size_t length) override;
+
+    Drawable getDrawable() const override { return m_drawable; }
+    GC getGC() const override { return m_gc; }
+
+  private:
+    enum Kind { FILLS, LINES, TEXT, KINDS };
+
+    struct TextItem {
+      int x, y;
+      int width;
+      size_t offset, length;   // Into m_text
+    };
+
+    // Everything of one kind and color queued since the last flush. Groups
+    // are reused between flushes to keep their capacity.
+    struct Group {
+      Kind kind;
+      unsigned long color;
+      Rect bounds;
+      std::vector<XRectangle> rects;
+      std::vector<XSegment> segments;
+      std::vector<TextItem> text;
+    };
+
+    // The group `rect` goes into, flushing first if it has to be drawn
+    // before something queued that it overlaps
+    Group& groupFor(Kind kind, unsigned long color, const Rect& rect);
+    void flushText(Group& group);
+
+    Drawable m_drawable = None;
+    GC m_gc = nullptr;
+
+    std::vector<Group> m_groups;
+    size_t m_groupCount = 0;     // In use, in the order they were started
+    std::string m_text;          // Characters of all queued text
+    std::vector<XTextItem> m_textItems;
+};
+
+} // namespace InWM
+
+#endif
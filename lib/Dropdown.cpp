@@ -1,7 +1,7 @@
 #include "Dropdown.hpp"
 #include "Application.hpp"
+#include "DrawContext.hpp"
 #include "GUI.hpp"
-#include "Window.hpp"
 #include <X11/X.h>
 #include <X11/Xlib.h>
 #include <algorithm>
@@ -16,13 +16,13 @@ namespace InWM {
   Dropdown::Dropdown(Application* app, const std::string& title, Widget* parent)
   : Widget(app, parent), m_title(title) { }
 
-  void Dropdown::draw(Drawable drawable, GC gc) {
+  void Dropdown::draw(DrawContext& dc) {
     if (!isVisible()) return;
     
     const Rect& bounds = getBounds();
     
     // Draw dropdown title (looks like a button when not open, or pressed when open)
-    drawRect3D(drawable, gc, bounds, !m_open);
+    drawRect3D(dc, bounds, !m_open);
     
     // Draw title text
     int textX = bounds.x + MENU_PADDING;
@@ -33,89 +33,74 @@ namespace InWM {
       textY += 1;
     }
     
-    XSetForeground(m_app->getDisplay(), gc, isEnabled() ? Colors::BLACK : Colors::GRAY_DARK);
-    XDrawString(m_app->getDisplay(), drawable, gc, textX, textY, m_title.c_str(), m_title.length());
+    unsigned long textColor = isEnabled() ? Colors::BLACK : Colors::GRAY_DARK;
+    dc.drawText(textColor, textX, textY, m_title);
     
-    // Draw dropdown arrow
+    // Draw dropdown arrow, one row at a time; it goes out with the text
     int arrowX = bounds.x + bounds.width - 12;
     int arrowY = bounds.y + bounds.height / 2;
-    XDrawLine(m_app->getDisplay(), drawable, gc, arrowX, arrowY - 2, arrowX + 6, arrowY - 2);
-    XDrawLine(m_app->getDisplay(), drawable, gc, arrowX + 1, arrowY - 1, arrowX + 5, arrowY - 1);
-    XDrawLine(m_app->getDisplay(), drawable, gc, arrowX + 2, arrowY, arrowX + 4, arrowY);
-    XDrawLine(m_app->getDisplay(), drawable, gc, arrowX + 3, arrowY + 1, arrowX + 3, arrowY + 1);
+    dc.drawLine(textColor, arrowX, arrowY - 2, arrowX + 6, arrowY - 2);
+    dc.drawLine(textColor, arrowX + 1, arrowY - 1, arrowX + 5, arrowY - 1);
+    dc.drawLine(textColor, arrowX + 2, arrowY, arrowX + 4, arrowY);
+    dc.drawLine(textColor, arrowX + 3, arrowY + 1, arrowX + 3, arrowY + 1);
     
     // Draw dropdown menu if open
     if (m_open) {
-      drawMenu(drawable, gc);
+      drawMenu(dc);
     }
     
     // Draw children
     for (auto& child : getChildren()) {
       if (child->isVisible()) {
-        child->draw(drawable, gc);
+        child->draw(dc);
       }
     }
   }
 
-  void Dropdown::drawMenu(Drawable drawable, GC gc) {
-    int menuWidth = getMenuWidth();
-    int menuHeight = getMenuHeight();
-    
-    // Menu position (below dropdown or at specified position)
-    int menuX = (m_menuX != 0) ? m_menuX : getBounds().x;
-    int menuY = (m_menuY != 0) ? m_menuY : getBounds().y + getBounds().height;
-    
-    // Ensure coordinates are reasonable
-    if (menuX < 0) menuX = 0;
-    if (menuY < 0) menuY = getBounds().y + getBounds().height;
-    
-    Rect menuRect(menuX, menuY, menuWidth, menuHeight);
+  void Dropdown::drawMenu(DrawContext& dc) {
+    Rect menuRect = getMenuRect();
+    int menuTop = menuRect.y + 1;
+    int menuBottom = menuRect.y + menuRect.height - 1;
     
     // Draw menu background with 3D border
-    XSetForeground(m_app->getDisplay(), gc, Colors::GRAY_LIGHT);
-    XFillRectangle(m_app->getDisplay(), drawable, gc, 
-                   menuRect.x, menuRect.y, menuRect.width, menuRect.height);
+    dc.fillRect(Colors::GRAY_LIGHT, menuRect);
     
     // Draw menu border
-    XSetForeground(m_app->getDisplay(), gc, Colors::BLACK);
-    XDrawRectangle(m_app->getDisplay(), drawable, gc, 
-                   menuRect.x, menuRect.y, menuRect.width - 1, menuRect.height - 1);
+    dc.drawRect(Colors::BLACK, menuRect);
     
-    // Draw menu items
-    int itemY = menuY + MENU_PADDING;
+    // Draw only the items in view, starting with the one at the top edge
+    auto first = std::upper_bound(m_itemOffsets.begin(), m_itemOffsets.end(), m_scrollOffset);
+    size_t start = first == m_itemOffsets.begin() ? 0 : first - m_itemOffsets.begin() - 1;
+    int contentBottom = m_scrollOffset + menuRect.height;
     
-    for (size_t i = 0; i < m_items.size(); ++i) {
+    for (size_t i = start; i < m_items.size() && m_itemOffsets[i] < contentBottom; ++i) {
         const auto& item = m_items[i];
+        int itemY = menuRect.y + m_itemOffsets[i] - m_scrollOffset;
         
         if (item.isSeparator) {
             // Draw separator line
             int sepY = itemY + SEPARATOR_HEIGHT / 2;
-            XSetForeground(m_app->getDisplay(), gc, Colors::GRAY_DARK);
-            XDrawLine(m_app->getDisplay(), drawable, gc, 
-                     menuX + MENU_PADDING, sepY, 
-                     menuX + menuWidth - MENU_PADDING, sepY);
-            itemY += SEPARATOR_HEIGHT;
+            if (sepY < menuTop || sepY >= menuBottom) continue;
+            dc.drawLine(Colors::GRAY_DARK,
+                        menuRect.x + MENU_PADDING, sepY, 
+                        menuRect.x + menuRect.width - MENU_PADDING, sepY);
         } else {
-            Rect itemRect(menuX + 1, itemY, menuWidth - 2, ITEM_HEIGHT);
+            // Rows cut by the edges get their highlight but no text
+            int top = std::max(itemY, menuTop);
+            int bottom = std::min(itemY + ITEM_HEIGHT, menuBottom);
             
             // Highlight selected item
             if ((int)i == m_selectedItem && item.enabled) {
-                XSetForeground(m_app->getDisplay(), gc, Colors::BLUE);
-                XFillRectangle(m_app->getDisplay(), drawable, gc, 
-                              itemRect.x, itemRect.y, itemRect.width, itemRect.height);
+                dc.fillRect(Colors::BLUE, Rect(menuRect.x + 1, top, menuRect.width - 2, bottom - top));
             }
             
-            // Draw item text
-            XSetForeground(m_app->getDisplay(), gc, 
-                          item.enabled ? 
-                          ((int)i == m_selectedItem ? Colors::WHITE : Colors::BLACK) : 
-                          Colors::GRAY_DARK);
+            if (top != itemY || bottom != itemY + ITEM_HEIGHT) continue;
             
-            XDrawString(m_app->getDisplay(), drawable, gc, 
-                       itemRect.x + MENU_PADDING, itemRect.y + 14, 
-                       item.text.c_str(), item.text.length());
-            
-            itemY += ITEM_HEIGHT;
+            // Draw item text
+            unsigned long color = item.enabled ? 
+                                  ((int)i == m_selectedItem ? Colors::WHITE : Colors::BLACK) : 
+                                  Colors::GRAY_DARK;
+            dc.drawText(color, menuRect.x + 1 + MENU_PADDING, itemY + 14, item.text);
         }
     }
   }
@@ -127,6 +112,13 @@ namespace InWM {
     
     switch (event.type) {
       case CLICK:
+        if (event.button == Button4 || event.button == Button5) {
+          // Wheel over the open menu scrolls it
+          if (isPointInMenu(event.x, event.y)) {
+            scrollMenu(event.button == Button4 ? -SCROLL_STEP : SCROLL_STEP, event.x, event.y);
+          }
+          return;
+        }
         if (event.button > 0) { // Button press
           if (bounds.contains(event.x, event.y)) {
             // Toggle dropdown - but make sure coordinates are correct
@@ -134,30 +126,11 @@ namespace InWM {
             return; // Don't process further
           } else if (m_open) {
             // Click outside dropdown title - check if in menu area
-            int menuWidth = getMenuWidth();
-            int menuHeight = getMenuHeight();
-            int menuX = (m_menuX != 0) ? m_menuX : bounds.x;
-            int menuY = (m_menuY != 0) ? m_menuY : bounds.y + bounds.height;
-            
-            Rect menuRect(menuX, menuY, menuWidth, menuHeight);
-            
-            // Debug: ensure menu coordinates are reasonable
-            if (menuX >= 0 && menuY >= 0 && menuRect.contains(event.x, event.y)) {
-                // Click in menu - find which item
-                int itemY = menuY + MENU_PADDING;
-                
-                for (size_t i = 0; i < m_items.size(); ++i) {
-                    const auto& item = m_items[i];
-                    
-                    if (item.isSeparator) {
-                        itemY += SEPARATOR_HEIGHT;
-                    } else {
-                        if (event.y >= itemY && event.y < itemY + ITEM_HEIGHT && item.enabled) {
-                            selectItem(i);
-                            return;
-                        }
-                        itemY += ITEM_HEIGHT;
-                    }
+            if (getMenuRect().contains(event.x, event.y)) {
+                int index = itemAt(event.x, event.y);
+                if (index >= 0) {
+                    selectItem(index);
+                    return;
                 }
             } else {
                 // Click outside menu - close it
@@ -169,127 +142,175 @@ namespace InWM {
           
       case HOVER:
         if (m_open) {
-          // Update selected item based on mouse position
-          int menuWidth = getMenuWidth();
-          int menuHeight = getMenuHeight();
-          int menuX = (m_menuX != 0) ? m_menuX : bounds.x;
-          int menuY = (m_menuY != 0) ? m_menuY : bounds.y + bounds.height;
-          
-          Rect menuRect(menuX, menuY, menuWidth, menuHeight);
-          
-          // Only process hover if coordinates are valid
-          if (menuX >= 0 && menuY >= 0 && menuRect.contains(event.x, event.y)) {
-            int itemY = menuY + MENU_PADDING;
-            m_selectedItem = -1;
-            
-            for (size_t i = 0; i < m_items.size(); ++i) {
-              const auto& item = m_items[i];
-              
-              if (item.isSeparator) {
-                itemY += SEPARATOR_HEIGHT;
-              } else {
-                if (event.y >= itemY && event.y < itemY + ITEM_HEIGHT && item.enabled) {
-                  m_selectedItem = i;
-                  break;
-                }
-                itemY += ITEM_HEIGHT;
-              }
-            }
-          } else {
-            m_selectedItem = -1;
-          }
+          setSelectedItem(itemAt(event.x, event.y));
         }
         break;
+        
+      case LEAVE:
+        setSelectedItem(-1);
+        break;
+
+      default:
+        break;
     }
   }
 
   void Dropdown::addItem(const MenuItem& item) {
     m_items.push_back(item);
+    m_layoutValid = false;
   }
 
   void Dropdown::addItem(const std::string& text, EventCallback callback) {
     m_items.emplace_back(text, callback);
+    m_layoutValid = false;
   }
 
   void Dropdown::addSeparator() {
     m_items.push_back(MenuItem::createSeparator());
+    m_layoutValid = false;
   }
 
   void Dropdown::clearItems() {
     m_items.clear();
+    m_selectedItem = -1;
+    m_layoutValid = false;
   }
 
   void Dropdown::setOpen(bool open) {
     if (m_open != open) {
       // If opening this dropdown, close all others first
       if (open && m_parent) {
-        printf("Msuk sini ga ya? Kalau iya berarti parentnya ada dong\n");
-        // Find parent window and close all its dropdowns
+        // Close the open popups of the top-level widget (the window)
         Widget* currentParent = m_parent;
         while (currentParent && currentParent->getParent()) {
           currentParent = currentParent->getParent();
         }
         
-        // If we found the window, close all its dropdowns
-        auto window = dynamic_cast<class Window*>(currentParent);
-        if (window) {
-          window->closeAllDropdowns();
-        }
+        currentParent->dismissPopups();
       }
       
+      // Repaint the menu area both before and after, so closing clears it
+      invalidate();
       m_open = open;
       m_selectedItem = -1;
+      m_scrollOffset = 0;
+      setLayer(open ? LAYER_POPUP : LAYER_CONTENT);
+      invalidate();
+      boundsChanged();
+    }
+  }
 
-      // Force an Expose event 
-      if (m_parent) {
-        printf("Help\n");
-        Widget* current = m_parent;
-        while (current->getParent()) {
-          current = current->getParent();
-        }
+  Rect Dropdown::getPaintBounds() const {
+    return m_open ? getBounds().united(getMenuRect()) : getBounds();
+  }
 
-        auto window = dynamic_cast<Window*>(current);
-        if (window) {
-          ::Window xid = window->getXWindow();
+  bool Dropdown::hitTest(int x, int y) const {
+    // The open menu takes clicks and hover too, even outside our bounds
+    return getBounds().contains(x, y) || isPointInMenu(x, y);
+  }
 
-          XEvent event;
-          memset(&event, 0, sizeof(event));
-          event.type = Expose;
-          event.xexpose.window = xid;
-          event.xexpose.x = 0;
-          event.xexpose.y = 0;
-          event.xexpose.width = window->getBounds().width;
-          event.xexpose.height = window->getBounds().height;
-          event.xexpose.count = 0;
+  Rect Dropdown::getMenuRect() const {
+    const Rect& bounds = getBounds();
+    int menuX = (m_menuX != 0) ? m_menuX : bounds.x;
+    int menuY = (m_menuY != 0) ? m_menuY : bounds.y + bounds.height;
+    
+    // Same clamping as drawMenu()
+    if (menuX < 0) menuX = 0;
+    if (menuY < 0) menuY = bounds.y + bounds.height;
+    
+    return Rect(menuX, menuY, getMenuWidth(),
+                std::min(getMenuHeight(), getMaxMenuHeight(menuY)));
+  }
 
-          XSendEvent(m_app->getDisplay(), xid, False, ExposureMask, &event);
-          XFlush(m_app->getDisplay());
-        }
-      }
-    }
+  int Dropdown::getMaxMenuHeight(int menuY) const {
+    // menuY is in window coordinates; not yet in a window, use the screen
+    const Widget* top = this;
+    while (top->getParent()) top = top->getParent();
+    int bottom = top != this ? top->getBounds().height : m_app->getScreenHeight();
+    return std::max(bottom - menuY, (int)MIN_MENU_HEIGHT);
   }
 
-  int Dropdown::getMenuHeight() const {
-    int height = MENU_PADDING * 2;
+  void Dropdown::scrollMenu(int delta, int x, int y) {
+    Rect menuRect = getMenuRect();
+    int maxOffset = getMenuHeight() - menuRect.height;
+    int offset = std::max(0, std::min(m_scrollOffset + delta, maxOffset));
+    if (offset == m_scrollOffset) return;
     
-    for (const auto& item : m_items) {
-      height += item.isSeparator ? SEPARATOR_HEIGHT : ITEM_HEIGHT;
-    }
-    
-    return height;
+    // Everything in view moves
+    m_scrollOffset = offset;
+    m_selectedItem = itemAt(x, y);
+    invalidate(menuRect);
   }
 
-  int Dropdown::getMenuWidth() const {
+  void Dropdown::updateLayout() const {
+    if (m_layoutValid) return;
+    
+    Font* font = m_app->getFont();
+    int offset = MENU_PADDING;
     int maxWidth = 120; // Minimum width
+    m_itemOffsets.clear();
     
     for (const auto& item : m_items) {
+      m_itemOffsets.push_back(offset);
+      offset += item.isSeparator ? SEPARATOR_HEIGHT : ITEM_HEIGHT;
+      
       if (!item.isSeparator) {
-        int itemWidth = item.text.length() * 8 + MENU_PADDING * 2;
+        // Not memoized, every item is measured just once here
+        int itemWidth = font->textWidth(item.text.data(), item.text.size()) + MENU_PADDING * 2;
         maxWidth = std::max(maxWidth, itemWidth);
       }
     }
     
-    return maxWidth;
+    m_menuHeight = offset + MENU_PADDING;
+    m_menuWidth = maxWidth;
+    m_layoutValid = true;
+  }
+
+  int Dropdown::getMenuHeight() const {
+    updateLayout();
+    return m_menuHeight;
+  }
+
+  int Dropdown::getMenuWidth() const {
+    updateLayout();
+    return m_menuWidth;
+  }
+
+  int Dropdown::itemAt(int x, int y) const {
+    Rect menuRect = getMenuRect();
+    if (!menuRect.contains(x, y)) return -1;
+    
+    // Last item starting at or above the point
+    int offset = y - menuRect.y + m_scrollOffset;
+    auto it = std::upper_bound(m_itemOffsets.begin(), m_itemOffsets.end(), offset);
+    if (it == m_itemOffsets.begin()) return -1;
+    
+    int index = it - m_itemOffsets.begin() - 1;
+    const auto& item = m_items[index];
+    if (item.isSeparator || !item.enabled || offset >= m_itemOffsets[index] + ITEM_HEIGHT) {
+      return -1;
+    }
+    return index;
+  }
+
+  Rect Dropdown::getItemRect(int index) const {
+    Rect menuRect = getMenuRect();
+    int top = std::max(menuRect.y + m_itemOffsets[index] - m_scrollOffset, menuRect.y + 1);
+    int bottom = std::min(menuRect.y + m_itemOffsets[index] - m_scrollOffset + ITEM_HEIGHT,
+                          menuRect.y + menuRect.height - 1);
+    return Rect(menuRect.x + 1, top, menuRect.width - 2, bottom - top);
+  }
+
+  void Dropdown::setSelectedItem(int index) {
+    if (index == m_selectedItem) return;
+    
+    if (m_open && m_selectedItem >= 0) {
+      invalidate(getItemRect(m_selectedItem));
+    }
+    m_selectedItem = index;
+    if (m_open && m_selectedItem >= 0) {
+      invalidate(getItemRect(m_selectedItem));
+    }
   }
 
   void Dropdown::selectItem(int index) {
@@ -309,18 +330,7 @@ namespace InWM {
   }
 
   bool Dropdown::isPointInMenu(int x, int y) const {
-    if (!m_open) return false;
-    
-    const Rect& bounds = getBounds();
-    int menuWidth = getMenuWidth();
-    int menuHeight = getMenuHeight();
-    int menuX = (m_menuX != 0) ? m_menuX : bounds.x;
-    int menuY = (m_menuY != 0) ? m_menuY : bounds.y + bounds.height;
-    
-    if (menuX < 0 || menuY < 0) return false;
-    
-    Rect menuRect(menuX, menuY, menuWidth, menuHeight);
-    return menuRect.contains(x, y);
+    return m_open && getMenuRect().contains(x, y);
   }
 
 } // namespace InWM
\ No newline at end of file
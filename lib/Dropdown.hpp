@@ -31,11 +31,14 @@ public:
     Dropdown(Application* app, const std::string& title, Widget* parent = nullptr);
     
     // Widget interface
-    void draw(Drawable drawable, GC gc) override;
+    void draw(DrawContext& dc) override;
     void handleEvent(const Event& event) override;
+    Rect getPaintBounds() const override;
+    bool hitTest(int x, int y) const override;
+    void dismissPopup() override { setOpen(false); }
     
     // Dropdown specific
-    void setTitle(const std::string& title) { m_title = title; }
+    void setTitle(const std::string& title) { m_title = title; invalidate(); }
     const std::string& getTitle() const { return m_title; }
     
     void addItem(const MenuItem& item);
@@ -53,21 +56,44 @@ public:
     bool isPointInMenu(int x, int y) const;
 
   private:
-    void drawMenu(Drawable drawable, GC gc);
+    void drawMenu(DrawContext& dc);
+    Rect getMenuRect() const;
     int getMenuHeight() const;
     int getMenuWidth() const;
     void selectItem(int index);
     
+    // Hover tracking; a change repaints just the old and new rows
+    int itemAt(int x, int y) const;
+    Rect getItemRect(int index) const;
+    void setSelectedItem(int index);
+    
+    // Menu size and item offsets only depend on the items, so they are
+    // computed once after the items change
+    void updateLayout() const;
+    
+    // The menu is painted into the window it belongs to, so menus that
+    // don't fit above the window's bottom edge show a view of the items and
+    // scroll it with the mouse wheel
+    int getMaxMenuHeight(int menuY) const;
+    void scrollMenu(int delta, int x, int y);
+    
     std::string m_title;
     std::vector<MenuItem> m_items;
     bool m_open = false;
     int m_selectedItem = -1;
     int m_menuX = 0, m_menuY = 0;
     
+    mutable bool m_layoutValid = false;
+    mutable std::vector<int> m_itemOffsets;   // Item tops in the menu, ascending
+    mutable int m_menuWidth = 0, m_menuHeight = 0;
+    int m_scrollOffset = 0;                   // Pixels scrolled past the top
+    
     // Menu appearance
     static const int ITEM_HEIGHT = 20;
     static const int SEPARATOR_HEIGHT = 8;
     static const int MENU_PADDING = 4;
+    static const int SCROLL_STEP = ITEM_HEIGHT * 3;
+    static const int MIN_MENU_HEIGHT = ITEM_HEIGHT * 3 + MENU_PADDING * 2;
 };
 
 } // namespace InWM
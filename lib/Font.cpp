@@ -0,0 +1,257 @@
+#include "Font.hpp"
+extern "C" {
+#include <X11/Xutil.h>
+}
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace InWM {
+
+namespace {
+
+// Loaded fonts by display and name; only touched on the X thread
+std::map<std::pair<Display*, std::string>, Font*>& registry() {
+  static std::map<std::pair<Display*, std::string>, Font*> fonts;
+  return fonts;
+}
+
+// Built-in glyphs for ' ' to '~', 5x7 pixels, one byte per column with the
+// top row in bit 0. Drawn in a 6x13 cell when there is no core font to
+// read glyphs from, e.g. without a display.
+const uint8_t BUILTIN_GLYPHS[95][5] = {
+  { 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5F, 0x00, 0x00 },  //   !
+  { 0x00, 0x07, 0x00, 0x07, 0x00 }, { 0x14, 0x7F, 0x14, 0x7F, 0x14 },  // " #
+  { 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },  // $ %
+  { 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 },  // & '
+  { 0x00, 0x1C, 0x22, 0x41, 0x00 }, { 0x00, 0x41, 0x22, 0x1C, 0x00 },  // ( )
+  { 0x14, 0x08, 0x3E, 0x08, 0x14 }, { 0x08, 0x08, 0x3E, 0x08, 0x08 },  // * +
+  { 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 },  // , -
+  { 0x00, 0x60, 0x60, 0x00, 0x00 }, { 0x20, 0x10, 0x08, 0x04, 0x02 },  // . /
+  { 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 },  // 0 1
+  { 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4B, 0x31 },  // 2 3
+  { 0x18, 0x14, 0x12, 0x7F, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 },  // 4 5
+  { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },  // 6 7
+  { 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1E },  // 8 9
+  { 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x00, 0x56, 0x36, 0x00, 0x00 },  // : ;
+  { 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 },  // < =
+  { 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 },  // > ?
+  { 0x32, 0x49, 0x79, 0x41, 0x3E }, { 0x7E, 0x11, 0x11, 0x11, 0x7E },  // @ A
+  { 0x7F, 0x49, 0x49, 0x49, 0x36 }, { 0x3E, 0x41, 0x41, 0x41, 0x22 },  // B C
+  { 0x7F, 0x41, 0x41, 0x22, 0x1C }, { 0x7F, 0x49, 0x49, 0x49, 0x41 },  // D E
+  { 0x7F, 0x09, 0x09, 0x01, 0x01 }, { 0x3E, 0x41, 0x41, 0x51, 0x32 },  // F G
+  { 0x7F, 0x08, 0x08, 0x08, 0x7F }, { 0x00, 0x41, 0x7F, 0x41, 0x00 },  // H I
+  { 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 },  // J K
+  { 0x7F, 0x40, 0x40, 0x40, 0x40 }, { 0x7F, 0x02, 0x04, 0x02, 0x7F },  // L M
+  { 0x7F, 0x04, 0x08, 0x10, 0x7F }, { 0x3E, 0x41, 0x41, 0x41, 0x3E },  // N O
+  { 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E },  // P Q
+  { 0x7F, 0x09, 0x19, 0x29, 0x46 }, { 0x46, 0x49, 0x49, 0x49, 0x31 },  // R S
+  { 0x01, 0x01, 0x7F, 0x01, 0x01 }, { 0x3F, 0x40, 0x40, 0x40, 0x3F },  // T U
+  { 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x7F, 0x20, 0x18, 0x20, 0x7F },  // V W
+  { 0x63, 0x14, 0x08, 0x14, 0x63 }, { 0x03, 0x04, 0x78, 0x04, 0x03 },  // X Y
+  { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7F, 0x41, 0x41, 0x00 },  // Z [
+  { 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7F, 0x00 },  // \ ]
+  { 0x04, 0x02, 0x01, 0x02, 0x04 }, { 0x40, 0x40, 0x40, 0x40, 0x40 },  // ^ _
+  { 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 },  // ` a
+  { 0x7F, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 },  // b c
+  { 0x38, 0x44, 0x44, 0x48, 0x7F }, { 0x38, 0x54, 0x54, 0x54, 0x18 },  // d e
+  { 0x08, 0x7E, 0x09, 0x01, 0x02 }, { 0x0C, 0x52, 0x52, 0x52, 0x3E },  // f g
+  { 0x7F, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7D, 0x40, 0x00 },  // h i
+  { 0x20, 0x40, 0x44, 0x3D, 0x00 }, { 0x7F, 0x10, 0x28, 0x44, 0x00 },  // j k
+  { 0x00, 0x41, 0x7F, 0x40, 0x00 }, { 0x7C, 0x04, 0x18, 0x04, 0x78 },  // l m
+  { 0x7C, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 },  // n o
+  { 0x7C, 0x14, 0x14, 0x14, 0x08 }, { 0x08, 0x14, 0x14, 0x18, 0x7C },  // p q
+  { 0x7C, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 },  // r s
+  { 0x04, 0x3F, 0x44, 0x40, 0x20 }, { 0x3C, 0x40, 0x40, 0x20, 0x7C },  // t u
+  { 0x1C, 0x20, 0x40, 0x20, 0x1C }, { 0x3C, 0x40, 0x30, 0x40, 0x3C },  // v w
+  { 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0C, 0x50, 0x50, 0x50, 0x3C },  // x y
+  { 0x44, 0x64, 0x54, 0x4C, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 },  // z {
+  { 0x00, 0x00, 0x7F, 0x00, 0x00 }, { 0x00, 0x41, 0x36, 0x08, 0x00 },  // | }
+  { 0x08, 0x04, 0x08, 0x10, 0x08 }                                     // ~
+};
+const int BUILTIN_WIDTH = 6;
+const int BUILTIN_TOP = 3;   // Empty rows above a glyph in its cell
+
+}
+
+const char* Font::DEFAULT_NAME = "fixed";
+
+Font* Font::get(Display* dpy, const std::string& name) {
+  auto& fonts = registry();
+  auto key = std::make_pair(dpy, name);
+  auto it = fonts.find(key);
+  if (it != fonts.end()) return it->second;
+
+  // Without a display every name gets the built-in font
+  XFontStruct* info = dpy ? XLoadQueryFont(dpy, name.c_str()) : nullptr;
+  if (!info && name != DEFAULT_NAME) {
+    if (dpy) fprintf(stderr, "Font %s not found, using %s\n", name.c_str(), DEFAULT_NAME);
+    Font* fallback = get(dpy, DEFAULT_NAME);
+    fonts[key] = fallback;
+    return fallback;
+  }
+
+  Font* font = new Font(dpy, info);
+  fonts[key] = font;
+  return font;
+}
+
+void Font::release(Display* dpy) {
+  auto& fonts = registry();
+  auto it = fonts.lower_bound(std::make_pair(dpy, std::string()));
+
+  // Fallbacks share the object of the font they stand in for
+  std::vector<Font*> owned;
+  while (it != fonts.end() && it->first.first == dpy) {
+    if (std::find(owned.begin(), owned.end(), it->second) == owned.end()) {
+      owned.push_back(it->second);
+    }
+    it = fonts.erase(it);
+  }
+  for (Font* font : owned) {
+    delete font;
+  }
+}
+
+Font::Font(Display* dpy, XFontStruct* info)
+: m_dpy(dpy), m_info(info), m_id(info ? info->fid : None) {
+  if (!info) {
+    // No fonts at all; the built-in one matches the server's usual 6x13
+    m_ascent = 10;
+    m_descent = 3;
+    for (int16_t& advance : m_advances) advance = BUILTIN_WIDTH;
+    return;
+  }
+
+  m_ascent = info->ascent;
+  m_descent = info->descent;
+
+  // Glyphs the font lacks are drawn as default_char, or not at all. Fonts
+  // with more than 256 glyphs (e.g. iso10646-1) are a matrix of rows;
+  // 8-bit text like ours is drawn from row 0.
+  unsigned firstRow = info->min_byte1, lastRow = info->max_byte1;
+  unsigned first = info->min_char_or_byte2, last = info->max_char_or_byte2;
+  auto advanceOf = [&](unsigned row, unsigned c) -> int {
+    if (row < firstRow || row > lastRow || c < first || c > last) return -1;
+    if (!info->per_char) return info->max_bounds.width;
+    const XCharStruct& glyph = info->per_char[(row - firstRow) * (last - first + 1) + c - first];
+    bool missing = glyph.width == 0 && glyph.lbearing == 0 && glyph.rbearing == 0 &&
+                   glyph.ascent == 0 && glyph.descent == 0;
+    return missing ? -1 : glyph.width;
+  };
+
+  int fallback = advanceOf(info->default_char >> 8, info->default_char & 0xFF);
+  if (fallback < 0) fallback = 0;
+  for (unsigned c = 0; c < 256; ++c) {
+    int advance = advanceOf(0, c);
+    m_advances[c] = advance >= 0 ? advance : fallback;
+  }
+}
+
+Font::~Font() {
+  if (m_info) {
+    XFreeFont(m_dpy, m_info);
+  }
+}
+
+int Font::textWidth(const std::string& text) {
+  auto it = m_widths.find(text);
+  if (it != m_widths.end()) return it->second;
+
+  if (m_widths.size() >= WIDTH_CACHE_LIMIT) {
+    m_widths.clear();
+  }
+  int width = textWidth(text.data(), text.size());
+  m_widths.emplace(text, width);
+  return width;
+}
+
+int Font::textWidth(const char* text, size_t length) const {
+  int width = 0;
+  for (size_t i = 0; i < length; ++i) {
+    width += m_advances[(unsigned char)text[i]];
+  }
+  return width;
+}
+
+void Font::loadGlyphs() {
+  int height = getHeight();
+  if (!m_info) {
+    m_glyphWidth = BUILTIN_WIDTH;
+    m_glyphs.assign(256 * BUILTIN_WIDTH * height, 0);
+    for (int c = ' '; c <= '~'; ++c) {
+      uint8_t* cell = &m_glyphs[c * BUILTIN_WIDTH * height];
+      for (int column = 0; column < 5; ++column) {
+        for (int row = 0; row < 7; ++row) {
+          if (BUILTIN_GLYPHS[c - ' '][column] >> row & 1) {
+            cell[(BUILTIN_TOP + row) * BUILTIN_WIDTH + column] = 0xFF;
+          }
+        }
+      }
+    }
+    return;
+  }
+
+  // Cells wide enough for glyphs that stick out either side of the pen
+  int left = std::max(0, -(int)m_info->min_bounds.lbearing);
+  int right = std::max((int)m_info->max_bounds.rbearing, (int)m_info->max_bounds.width);
+  m_glyphOriginX = left;
+  m_glyphWidth = left + right;
+
+  // Draw all 256 characters into a 16x16 bitmap, one row of cells per
+  // XDrawText, and read it back once
+  int atlasWidth = 16 * m_glyphWidth;
+  int atlasHeight = 16 * height;
+  Pixmap atlas = XCreatePixmap(m_dpy, DefaultRootWindow(m_dpy), atlasWidth, atlasHeight, 1);
+  XGCValues values;
+  values.font = m_id;
+  values.foreground = 0;
+  GC gc = XCreateGC(m_dpy, atlas, GCFont | GCForeground, &values);
+  XFillRectangle(m_dpy, atlas, gc, 0, 0, atlasWidth, atlasHeight);
+  XSetForeground(m_dpy, gc, 1);
+
+  char chars[256];
+  for (int c = 0; c < 256; ++c) chars[c] = (char)c;
+  for (int row = 0; row < 16; ++row) {
+    XTextItem items[16];
+    for (int col = 0; col < 16; ++col) {
+      int c = row * 16 + col;
+      items[col].chars = &chars[c];
+      items[col].nchars = 1;
+      items[col].delta = col == 0 ? 0 : m_glyphWidth - m_advances[c - 1];
+      items[col].font = None;
+    }
+    XDrawText(m_dpy, atlas, gc, left, row * height + m_ascent, items, 16);
+  }
+
+  XImage* image = XGetImage(m_dpy, atlas, 0, 0, atlasWidth, atlasHeight, 1, XYPixmap);
+  XFreeGC(m_dpy, gc);
+  XFreePixmap(m_dpy, atlas);
+
+  m_glyphs.assign(256 * m_glyphWidth * height, 0);
+  if (!image) return;
+  for (int c = 0; c < 256; ++c) {
+    uint8_t* cell = &m_glyphs[c * m_glyphWidth * height];
+    int cellX = (c % 16) * m_glyphWidth;
+    int cellY = (c / 16) * height;
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < m_glyphWidth; ++x) {
+        cell[y * m_glyphWidth + x] = XGetPixel(image, cellX + x, cellY + y) ? 0xFF : 0;
+      }
+    }
+  }
+  XDestroyImage(image);
+}
+
+size_t Font::fit(const char* text, size_t length, int maxWidth) const {
+  int width = 0;
+  for (size_t i = 0; i < length; ++i) {
+    width += m_advances[(unsigned char)text[i]];
+    if (width > maxWidth) return i;
+  }
+  return length;
+}
+
+} // namespace InWM
@@ -0,0 +1,85 @@
+#ifndef INWM_FONT_HPP
+#define INWM_FONT_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace InWM {
+
+// A core X font with its metrics kept on the client. Each font is loaded
+// once per display; XLoadQueryFont brings every glyph's metrics along, so
+// measuring text never goes back to the server after that.
+class Font {
+  public:
+    // What widgets draw with unless told otherwise
+    static const char* DEFAULT_NAME;
+
+    // Load `name` the first time, then return the same object. Falls back to
+    // "fixed" if the font does not exist; never returns nullptr. Without a
+    // display (nullptr) this is a built-in 6x13 font for drawing client-side.
+    static Font* get(Display* dpy, const std::string& name = DEFAULT_NAME);
+
+    // Free every font loaded for `dpy`. Call before closing the display.
+    static void release(Display* dpy);
+
+    Font(const Font&) = delete;
+    Font& operator=(const Font&) = delete;
+
+    // For XSetFont; None if not even "fixed" could be loaded
+    ::Font getId() const { return m_id; }
+
+    int getAscent() const { return m_ascent; }
+    int getDescent() const { return m_descent; }
+    int getHeight() const { return m_ascent + m_descent; }
+
+    // Advance of one byte, as XDrawString would draw it
+    int charWidth(unsigned char c) const { return m_advances[c]; }
+
+    // Pixel width of a string; remembered for strings seen before
+    int textWidth(const std::string& text);
+    int textWidth(const char* text, size_t length) const;
+
+    // Longest prefix of `text` no wider than `maxWidth`, in bytes
+    size_t fit(const char* text, size_t length, int maxWidth) const;
+
+    // Glyph shapes for drawing text in client memory. Each glyph is a cell
+    // of getGlyphWidth() x getHeight() coverage bytes (0 or 0xFF) with the
+    // pen at (getGlyphOriginX(), getAscent()). Fetched from the server in
+    // one go the first time they are needed.
+    const uint8_t* getGlyph(unsigned char c) {
+      if (m_glyphs.empty()) loadGlyphs();
+      return &m_glyphs[c * m_glyphWidth * getHeight()];
+    }
+    int getGlyphWidth() { if (m_glyphs.empty()) loadGlyphs(); return m_glyphWidth; }
+    int getGlyphOriginX() { if (m_glyphs.empty()) loadGlyphs(); return m_glyphOriginX; }
+
+  private:
+    Font(Display* dpy, XFontStruct* info);
+    ~Font();
+
+    void loadGlyphs();
+
+    // Memoized widths are dropped wholesale past this many strings
+    static const size_t WIDTH_CACHE_LIMIT = 4096;
+
+    Display* m_dpy;
+    XFontStruct* m_info;
+    ::Font m_id;
+    int m_ascent;
+    int m_descent;
+    int16_t m_advances[256];
+    std::unordered_map<std::string, int> m_widths;
+
+    int m_glyphWidth = 0;
+    int m_glyphOriginX = 0;
+    std::vector<uint8_t> m_glyphs;   // 256 cells, by character
+};
+
+} // namespace InWM
+
+#endif
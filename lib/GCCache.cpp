@@ -0,0 +1,52 @@
+#include "GCCache.hpp"
+#include "Font.hpp"
+#include <climits>
+#include <map>
+#include <tuple>
+
+namespace InWM {
+
+namespace {
+
+using Key = std::tuple<Display*, unsigned long, ::Font, int>;
+
+// Only touched on the X thread, like the font registry
+std::map<Key, GC>& registry() {
+  static std::map<Key, GC> gcs;
+  return gcs;
+}
+
+}
+
+GC GCCache::get(Display* dpy, unsigned long color, const Font* font, int lineStyle) {
+  ::Font fontId = font ? font->getId() : None;
+  auto& gcs = registry();
+  Key key(dpy, color, fontId, lineStyle);
+  auto it = gcs.find(key);
+  if (it != gcs.end()) return it->second;
+
+  XGCValues values;
+  values.foreground = color;
+  values.line_style = lineStyle;
+  values.graphics_exposures = False;
+  unsigned long mask = GCForeground | GCLineStyle | GCGraphicsExposures;
+  if (fontId != None) {
+    values.font = fontId;
+    mask |= GCFont;
+  }
+
+  GC gc = XCreateGC(dpy, DefaultRootWindow(dpy), mask, &values);
+  gcs.emplace(key, gc);
+  return gc;
+}
+
+void GCCache::release(Display* dpy) {
+  auto& gcs = registry();
+  auto it = gcs.lower_bound(Key(dpy, 0, 0, INT_MIN));
+  while (it != gcs.end() && std::get<0>(it->first) == dpy) {
+    XFreeGC(dpy, it->second);
+    it = gcs.erase(it);
+  }
+}
+
+} // namespace InWM
@@ -0,0 +1,31 @@
+#ifndef INWM_GCCACHE_HPP
+#define INWM_GCCACHE_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+
+namespace InWM {
+
+class Font;
+
+// One GC per (color, font, line style), created the first time it is asked
+// for and kept until the display is released. Picking the GC for a color
+// costs nothing on the wire, where XSetForeground on a shared GC is a
+// request every time the color changes.
+//
+// The GCs are shared, so never change them (foreground, clip, ...); create
+// a GC of your own for that. They are made for the default screen and
+// depth, and never generate GraphicsExpose.
+class GCCache {
+  public:
+    static GC get(Display* dpy, unsigned long color, const Font* font = nullptr,
+                  int lineStyle = LineSolid);
+
+    // Free every GC made for `dpy`. Call before closing the display.
+    static void release(Display* dpy);
+};
+
+} // namespace InWM
+
+#endif
@@ -1,5 +1,6 @@
 #include "GUI.hpp"
 #include "Application.hpp"
+#include "DrawContext.hpp"
 #include <algorithm>
 
 namespace InWM {
@@ -10,22 +11,158 @@ Widget::Widget(Application* app, Widget* parent)
 void Widget::resize(int width, int height) {
   m_bounds.width = width;
   m_bounds.height = height;
+  boundsChanged();
 }
 
 void Widget::move(int x, int y) {
   m_bounds.x = x;
   m_bounds.y = y;
+  boundsChanged();
+}
+
+void Widget::boundsChanged() {
+  if (m_parent) {
+    m_parent->m_hitGridValid = false;
+  }
+}
+
+void Widget::setLayer(Layer layer) {
+  if (layer == m_layer) return;
+  
+  m_layer = layer;
+  if (m_parent) {
+    m_parent->m_renderListsValid = false;
+    m_parent->m_hitGridValid = false;
+  }
+}
+
+const std::vector<Widget*>& Widget::getRenderList(Layer layer) {
+  updateRenderLists();
+  return m_renderLists[layer];
+}
+
+void Widget::updateRenderLists() {
+  if (m_renderListsValid) return;
+  
+  for (auto& list : m_renderLists) {
+    list.clear();
+  }
+  for (const auto& child : m_children) {
+    m_renderLists[child->m_layer].push_back(child);
+  }
+  m_renderListsValid = true;
+}
+
+void Widget::dismissPopups() {
+  // Dismissing moves them out of the list
+  std::vector<Widget*> popups = getRenderList(LAYER_POPUP);
+  for (Widget* popup : popups) {
+    popup->dismissPopup();
+  }
+}
+
+void Widget::widgetRemoved(Widget* widget) {
+  if (m_parent) {
+    m_parent->widgetRemoved(widget);
+  }
+}
+
+Widget* Widget::findWidgetAt(int x, int y) {
+  Widget* child = childAt(x, y);
+  if (!child) return nullptr;
+  
+  Widget* descendant = child->findWidgetAt(x, y);
+  return descendant ? descendant : child;
+}
+
+Widget* Widget::childAt(int x, int y) {
+  if (m_children.empty()) return nullptr;
+  
+  auto accept = [x, y](Widget* child) {
+    return child->isVisible() && child->hitTest(x, y);
+  };
+  
+  // Search children from the top layer down, each in reverse paint order
+  if (m_children.size() < HIT_GRID_THRESHOLD) {
+    for (int layer = LAYER_COUNT - 1; layer >= 0; --layer) {
+      const auto& list = getRenderList((Layer)layer);
+      for (auto it = list.rbegin(); it != list.rend(); ++it) {
+        if (accept(*it)) return *it;
+      }
+    }
+    return nullptr;
+  }
+  
+  if (!m_hitGridValid) {
+    m_hitOrder.clear();
+    for (int layer = 0; layer < LAYER_COUNT; ++layer) {
+      const auto& list = getRenderList((Layer)layer);
+      m_hitOrder.insert(m_hitOrder.end(), list.begin(), list.end());
+    }
+    
+    std::vector<Rect> rects;
+    rects.reserve(m_hitOrder.size());
+    for (Widget* child : m_hitOrder) {
+      rects.push_back(child->getPaintBounds());
+    }
+    m_hitGrid.build(rects);
+    m_hitGridValid = true;
+  }
+  
+  int index = m_hitGrid.find(x, y, [&](size_t i) { return accept(m_hitOrder[i]); });
+  return index >= 0 ? m_hitOrder[index] : nullptr;
+}
+
+void Widget::invalidate(const Rect& rect) {
+  if (m_parent && !rect.isEmpty()) {
+    m_parent->invalidate(rect);
+  }
 }
 
 void Widget::setEventCallback(EventType type, EventCallback callback) {
-  // Remove existing callback for this type
-  auto it = std::find_if(m_callbacks.begin(), m_callbacks.end(),
-                        [type](const auto& pair) { return pair.first == type; });
-  if (it != m_callbacks.end()) {
-      m_callbacks.erase(it);
+  addListener(LISTEN_BUBBLE, type, std::move(callback), true);
+}
+
+void Widget::addEventCallback(EventType type, EventCallback callback) {
+  addListener(LISTEN_BUBBLE, type, std::move(callback), false);
+}
+
+void Widget::setCaptureCallback(EventType type, EventCallback callback) {
+  addListener(LISTEN_CAPTURE, type, std::move(callback), true);
+}
+
+void Widget::addCaptureCallback(EventType type, EventCallback callback) {
+  addListener(LISTEN_CAPTURE, type, std::move(callback), false);
+}
+
+void Widget::addListener(ListenerPhase phase, EventType type, EventCallback callback, bool replace) {
+  // Inserting would move the listener that is running, or shift a slot
+  // the loop is still walking
+  if (m_runningListeners) {
+    m_pendingListeners.push_back({ phase, type, std::move(callback), replace });
+    return;
   }
+  applyListener(phase, type, std::move(callback), replace);
+}
+
+void Widget::applyListener(ListenerPhase phase, EventType type, EventCallback callback, bool replace) {
+  int slot = phase * EVENT_TYPE_COUNT + type;
   
-  m_callbacks.emplace_back(type, callback);
+  if (replace) {
+    int count = m_slotStart[slot + 1] - m_slotStart[slot];
+    m_listeners.erase(m_listeners.begin() + m_slotStart[slot],
+                      m_listeners.begin() + m_slotStart[slot + 1]);
+    for (int s = slot + 1; s <= LISTENER_SLOTS; ++s) {
+      m_slotStart[s] -= count;
+    }
+  }
+  
+  if (callback) {
+    m_listeners.insert(m_listeners.begin() + m_slotStart[slot + 1], std::move(callback));
+    for (int s = slot + 1; s <= LISTENER_SLOTS; ++s) {
+      m_slotStart[s]++;
+    }
+  }
 }
 
 void Widget::triggerEvent(const Event& event) {
@@ -33,71 +170,105 @@ void Widget::triggerEvent(const Event& event) {
   handleEvent(event);
   
   // Then call registered callbacks
-  for (const auto& [eventType, callback] : m_callbacks) {
-    if (eventType == event.type) {
-      callback(event);
-    }
+  runListeners(LISTEN_BUBBLE, event);
+}
+
+void Widget::runListeners(ListenerPhase phase, const Event& event) {
+  int slot = phase * EVENT_TYPE_COUNT + event.type;
+  if (m_slotStart[slot] == m_slotStart[slot + 1]) return;
+  
+  // Nothing moves m_listeners until the outermost call is done (see
+  // addListener), so the range stays valid even if listeners dispatch again
+  ++m_runningListeners;
+  const EventCallback* listener = m_listeners.data() + m_slotStart[slot];
+  const EventCallback* end = m_listeners.data() + m_slotStart[slot + 1];
+  for (; listener != end; ++listener) {
+    (*listener)(event);
+  }
+  if (--m_runningListeners > 0 || m_pendingListeners.empty()) return;
+  
+  std::vector<PendingListener> pending;
+  pending.swap(m_pendingListeners);
+  for (PendingListener& change : pending) {
+    applyListener(change.phase, change.type, std::move(change.callback), change.replace);
+  }
+}
+
+void Widget::dispatchEvent(Widget* target, Event event) {
+  event.target = target;
+  
+  // Ancestors of the target up to us, nearest first
+  std::vector<Widget*> path;
+  for (Widget* widget = target; widget != this && widget->m_parent; ) {
+    widget = widget->m_parent;
+    path.push_back(widget);
+  }
+  
+  event.phase = CAPTURE;
+  for (auto it = path.rbegin(); it != path.rend() && !event.stopped; ++it) {
+    event.currentTarget = *it;
+    (*it)->runListeners(LISTEN_CAPTURE, event);
+  }
+  
+  if (!event.stopped) {
+    event.phase = AT_TARGET;
+    event.currentTarget = target;
+    target->triggerEvent(event);
+  }
+  
+  event.phase = BUBBLE;
+  for (auto it = path.begin(); it != path.end() && !event.stopped; ++it) {
+    event.currentTarget = *it;
+    (*it)->runListeners(LISTEN_BUBBLE, event);
   }
 }
 
 void Widget::addChild(std::shared_ptr<Widget> child) {
+  addChild(child.get());
+  m_ownedChildren.push_back(std::move(child));
+}
+
+void Widget::addChild(Widget* child) {
   m_children.push_back(child);
   // Set this widget as the parent of the child
   child->m_parent = this;
+  m_hitGridValid = false;
+  m_renderListsValid = false;
 }
 
 void Widget::removeChild(Widget* child) {
-  m_children.erase(
-    std::remove_if(m_children.begin(), m_children.end(),
+  widgetRemoved(child);
+  m_hitGridValid = false;
+  m_renderListsValid = false;
+  m_children.erase(std::remove(m_children.begin(), m_children.end(), child), m_children.end());
+  
+  // Last, since this may destroy it
+  m_ownedChildren.erase(
+    std::remove_if(m_ownedChildren.begin(), m_ownedChildren.end(),
                   [child](const auto& ptr) { return ptr.get() == child; }),
-    m_children.end()
+    m_ownedChildren.end()
   );
 }
 
-void Widget::drawRect3D(Drawable drawable, GC gc, const Rect& rect, bool raised) {
+void Widget::drawRect3D(DrawContext& dc, const Rect& rect, bool raised) {
+  int right = rect.x + rect.width - 1;
+  int bottom = rect.y + rect.height - 1;
+  
   // Fill background
-  XSetForeground(m_app->getDisplay(), gc, Colors::BUTTON_FACE);
-  XFillRectangle(m_app->getDisplay(), drawable, gc, 
-                  rect.x, rect.y, rect.width, rect.height);
-  
-  // Draw 3D border
-  if (raised) {
-    // Light border (top, left)
-    XSetForeground(m_app->getDisplay(), gc, Colors::WHITE);
-    XDrawLine(m_app->getDisplay(), drawable, gc, 
-              rect.x, rect.y, rect.x + rect.width - 1, rect.y);
-    XDrawLine(m_app->getDisplay(), drawable, gc, 
-              rect.x, rect.y, rect.x, rect.y + rect.height - 1);
-    
-    // Dark border (bottom, right)
-    XSetForeground(m_app->getDisplay(), gc, Colors::GRAY_DARK);
-    XDrawLine(m_app->getDisplay(), drawable, gc, 
-              rect.x, rect.y + rect.height - 1, 
-              rect.x + rect.width - 1, rect.y + rect.height - 1);
-    XDrawLine(m_app->getDisplay(), drawable, gc, 
-              rect.x + rect.width - 1, rect.y, 
-              rect.x + rect.width - 1, rect.y + rect.height - 1);
-  } else {
-    // Inverted for pressed appearance
-    XSetForeground(m_app->getDisplay(), gc, Colors::GRAY_DARK);
-    XDrawLine(m_app->getDisplay(), drawable, gc, 
-              rect.x, rect.y, rect.x + rect.width - 1, rect.y);
-    XDrawLine(m_app->getDisplay(), drawable, gc, 
-              rect.x, rect.y, rect.x, rect.y + rect.height - 1);
-    
-    XSetForeground(m_app->getDisplay(), gc, Colors::WHITE);
-    XDrawLine(m_app->getDisplay(), drawable, gc, 
-              rect.x, rect.y + rect.height - 1, 
-              rect.x + rect.width - 1, rect.y + rect.height - 1);
-    XDrawLine(m_app->getDisplay(), drawable, gc, 
-              rect.x + rect.width - 1, rect.y, 
-              rect.x + rect.width - 1, rect.y + rect.height - 1);
-  }
+  dc.fillRect(Colors::BUTTON_FACE, rect);
+  
+  // Light border on top and left, dark on bottom and right; swapped for
+  // the pressed appearance
+  unsigned long topLeft = raised ? Colors::WHITE : Colors::GRAY_DARK;
+  unsigned long bottomRight = raised ? Colors::GRAY_DARK : Colors::WHITE;
+  dc.drawLine(topLeft, rect.x, rect.y, right, rect.y);
+  dc.drawLine(topLeft, rect.x, rect.y, rect.x, bottom);
+  dc.drawLine(bottomRight, rect.x, bottom, right, bottom);
+  dc.drawLine(bottomRight, right, rect.y, right, bottom);
 }
 
-void Widget::drawText(Drawable drawable, GC gc, const std::string& text, int x, int y) {
-  XSetForeground(m_app->getDisplay(), gc, Colors::BLACK);
-  XDrawString(m_app->getDisplay(), drawable, gc, x, y, text.c_str(), text.length());
+void Widget::drawText(DrawContext& dc, const std::string& text, int x, int y) {
+  dc.drawText(Colors::BLACK, x, y, text);
 }
 
 } // namespace InWM
\ No newline at end of file
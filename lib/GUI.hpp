@@ -5,16 +5,19 @@ extern "C" {
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 }
+#include "HitGrid.hpp"
+#include "SmallFunction.hpp"
+#include <algorithm>
 #include <vector>
 #include <memory>
 #include <string>
-#include <functional>
 
 namespace InWM {
 
 // Forward declarations
 class Widget;
 class Application;
+class DrawContext;
 
 // System 8 color scheme
 struct Colors {
@@ -30,11 +33,32 @@ struct Colors {
 enum EventType {
   CLICK,
   HOVER,
+  ENTER,              // Pointer moved onto the widget
+  LEAVE,              // Pointer moved off it (or out of the window)
   FOCUS,
   UNFOCUS,
   KEY_PRESS
 };
 
+// Not an enumerator, so switches over EventType need no case for it
+const int EVENT_TYPE_COUNT = KEY_PRESS + 1;
+
+// Stacking layers among a widget's children, painted and hit-tested from
+// the bottom up
+enum Layer {
+  LAYER_CONTENT,      // Ordinary widgets
+  LAYER_OVERLAY,      // Above content, e.g. tooltips
+  LAYER_POPUP,        // Open menus
+  LAYER_COUNT
+};
+
+// Where a dispatched event is on its way (see Widget::dispatchEvent)
+enum EventPhase {
+  CAPTURE,            // Going down from the window to the target
+  AT_TARGET,
+  BUBBLE              // Going back up
+};
+
 // Event data structure
 struct Event {
   EventType type;
@@ -42,10 +66,17 @@ struct Event {
   int button;         // Mouse button (if applicable)
   KeySym key;         // Key pressed (if applicable)
   Widget* target;     // Widget that received the event
+  Widget* currentTarget = nullptr;  // Widget whose callbacks are running
+  EventPhase phase = AT_TARGET;
+  
+  // Keep the event from reaching the remaining widgets on its path
+  void stopPropagation() const { stopped = true; }
+  mutable bool stopped = false;
 };
 
-// Callback function type
-using EventCallback = std::function<void(const Event&)>;
+// Callback function type; lambdas capturing up to four pointers' worth
+// are stored without allocating
+using EventCallback = SmallFunction<void(const Event&)>;
 
 // Base rectangle structure
 struct Rect {
@@ -57,6 +88,24 @@ struct Rect {
   bool contains(int px, int py) const {
     return px >= x && px < x + width && py >= y && py < y + height;
   }
+  
+  bool isEmpty() const { return width <= 0 || height <= 0; }
+  
+  bool intersects(const Rect& other) const {
+    return x < other.x + other.width && other.x < x + width &&
+           y < other.y + other.height && other.y < y + height;
+  }
+  
+  // Smallest rectangle covering both
+  Rect united(const Rect& other) const {
+    if (isEmpty()) return other;
+    if (other.isEmpty()) return *this;
+    int left = std::min(x, other.x);
+    int top = std::min(y, other.y);
+    int right = std::max(x + width, other.x + other.width);
+    int bottom = std::max(y + height, other.y + other.height);
+    return Rect(left, top, right - left, bottom - top);
+  }
 };
 
 // Base widget class
@@ -66,13 +115,13 @@ class Widget {
     virtual ~Widget() = default;
 
     // Core methods
-    virtual void draw(Drawable drawable, GC gc) = 0;
+    virtual void draw(DrawContext& dc) = 0;
     virtual void handleEvent(const Event& event) {}
     virtual void resize(int width, int height);
     virtual void move(int x, int y);
     
     // Properties
-    void setBounds(const Rect& bounds) { m_bounds = bounds; }
+    void setBounds(const Rect& bounds) { m_bounds = bounds; boundsChanged(); }
     const Rect& getBounds() const { return m_bounds; }
     
     void setVisible(bool visible) { m_visible = visible; }
@@ -81,28 +130,110 @@ class Widget {
     void setEnabled(bool enabled) { m_enabled = enabled; }
     bool isEnabled() const { return m_enabled; }
     
-    // Event handling
+    void setLayer(Layer layer);
+    Layer getLayer() const { return m_layer; }
+    
+    // Children in `layer`, in paint order. Rebuilt after children are
+    // added, removed or change layer.
+    const std::vector<Widget*>& getRenderList(Layer layer);
+    
+    // Close every child in LAYER_POPUP through dismissPopup()
+    void dismissPopups();
+    virtual void dismissPopup() {}
+    
+    // Everything draw() may touch, in window coordinates. Defaults to the
+    // bounds; widgets that draw outside them (e.g. an open menu) widen it.
+    virtual Rect getPaintBounds() const { return m_bounds; }
+    
+    // Ask for `rect` (window coordinates) to be repainted. The request goes
+    // up to the Window, which repaints only the widgets it touches.
+    virtual void invalidate(const Rect& rect);
+    void invalidate() { invalidate(getPaintBounds()); }
+    
+    // Hit testing. Children are expected to stay within their parent's
+    // paint bounds; findWidgetAt returns the deepest descendant under the
+    // point, or nullptr if no child is.
+    virtual bool hitTest(int x, int y) const { return m_bounds.contains(x, y); }
+    Widget* findWidgetAt(int x, int y);
+    
+    // Event handling. set* replaces the listeners for `type`, add* appends
+    // one; capture listeners run while an event goes down to a descendant.
+    // Changes made by a listener take effect once the widget has finished
+    // running listeners, so they don't affect the event being dispatched.
     void setEventCallback(EventType type, EventCallback callback);
+    void addEventCallback(EventType type, EventCallback callback);
+    void setCaptureCallback(EventType type, EventCallback callback);
+    void addCaptureCallback(EventType type, EventCallback callback);
     void triggerEvent(const Event& event);
     
-    // Hierarchy
+    // Send `event` to `target`, a descendant (or this widget itself): capture
+    // callbacks run from here down to the target's parent, then the target
+    // handles it, then callbacks run back up here. Any of them may call
+    // stopPropagation().
+    void dispatchEvent(Widget* target, Event event);
+    
+    // Hierarchy. A shared_ptr child is kept alive by its parent; a raw
+    // pointer child is owned elsewhere, e.g. by the window's arena.
     void addChild(std::shared_ptr<Widget> child);
+    void addChild(Widget* child);
     void removeChild(Widget* child);
-    const std::vector<std::shared_ptr<Widget>>& getChildren() const { return m_children; }
+    const std::vector<Widget*>& getChildren() const { return m_children; }
     Widget* getParent() const { return m_parent; }
     
     // Drawing helpers
-    void drawRect3D(Drawable drawable, GC gc, const Rect& rect, bool raised = true);
-    void drawText(Drawable drawable, GC gc, const std::string& text, int x, int y);
+    void drawRect3D(DrawContext& dc, const Rect& rect, bool raised = true);
+    void drawText(DrawContext& dc, const std::string& text, int x, int y);
 
   protected:
+    // Call when getPaintBounds() changes, so the parent re-indexes us
+    void boundsChanged();
+    
+    // Called on the way up before `widget` leaves the tree
+    virtual void widgetRemoved(Widget* widget);
+    
     Application* m_app;
     Widget* m_parent;
     Rect m_bounds;
     bool m_visible = true;
     bool m_enabled = true;
-    std::vector<std::shared_ptr<Widget>> m_children;
-    std::vector<std::pair<EventType, EventCallback>> m_callbacks;
+    Layer m_layer = LAYER_CONTENT;
+    std::vector<Widget*> m_children;
+    std::vector<std::shared_ptr<Widget>> m_ownedChildren;
+  private:
+    // One slot per event type and phase. The listeners share one vector,
+    // grouped by slot: slot s is m_listeners[m_slotStart[s] .. m_slotStart[s + 1]).
+    // Widgets without listeners allocate nothing.
+    enum ListenerPhase { LISTEN_CAPTURE, LISTEN_BUBBLE, LISTEN_PHASES };
+    static const int LISTENER_SLOTS = LISTEN_PHASES * EVENT_TYPE_COUNT;
+    
+    // Added or replaced while listeners were running
+    struct PendingListener {
+      ListenerPhase phase;
+      EventType type;
+      EventCallback callback;
+      bool replace;
+    };
+    
+    void addListener(ListenerPhase phase, EventType type, EventCallback callback, bool replace);
+    void applyListener(ListenerPhase phase, EventType type, EventCallback callback, bool replace);
+    void runListeners(ListenerPhase phase, const Event& event);
+    
+    std::vector<EventCallback> m_listeners;
+    uint32_t m_slotStart[LISTENER_SLOTS + 1] = {};
+    int m_runningListeners = 0;   // Nesting depth of runListeners
+    std::vector<PendingListener> m_pendingListeners;
+
+    void updateRenderLists();
+    Widget* childAt(int x, int y);
+    
+    // Few children are faster to scan than to index
+    static const size_t HIT_GRID_THRESHOLD = 16;
+    HitGrid m_hitGrid;
+    std::vector<Widget*> m_hitOrder;   // All layers, bottom to top, as indexed
+    bool m_hitGridValid = false;
+    
+    std::vector<Widget*> m_renderLists[LAYER_COUNT];
+    bool m_renderListsValid = false;
 };
 
 } // namespace InWM
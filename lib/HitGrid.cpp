@@ -0,0 +1,74 @@
+#include "HitGrid.hpp"
+#include "GUI.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace InWM {
+
+namespace {
+
+// Bounds on the cell size, and on the cell count for huge, sparse areas
+const int MIN_CELL_SIZE = 16;
+const long MAX_CELLS = 1 << 16;
+
+}
+
+void HitGrid::clear() {
+  m_columns = m_rows = 0;
+  m_cellStart.clear();
+  m_items.clear();
+}
+
+void HitGrid::build(const std::vector<Rect>& rects) {
+  clear();
+
+  Rect area;
+  for (const Rect& rect : rects) {
+    area = area.united(rect);
+  }
+  if (area.isEmpty()) return;
+
+  // About one child per cell on average
+  double average = (double)area.width * area.height / rects.size();
+  m_cellSize = std::max(MIN_CELL_SIZE, (int)std::sqrt(average));
+  while (((long)area.width / m_cellSize + 1) * ((long)area.height / m_cellSize + 1) > MAX_CELLS) {
+    m_cellSize *= 2;
+  }
+
+  m_left = area.x;
+  m_top = area.y;
+  m_columns = (area.width + m_cellSize - 1) / m_cellSize;
+  m_rows = (area.height + m_cellSize - 1) / m_cellSize;
+
+  // Cells covered by each rect, as inclusive column/row ranges
+  auto forEachCell = [this](const Rect& rect, auto visit) {
+    if (rect.isEmpty()) return;
+    int column0 = (rect.x - m_left) / m_cellSize;
+    int row0 = (rect.y - m_top) / m_cellSize;
+    int column1 = (rect.x + rect.width - 1 - m_left) / m_cellSize;
+    int row1 = (rect.y + rect.height - 1 - m_top) / m_cellSize;
+    for (int row = row0; row <= row1; ++row) {
+      for (int column = column0; column <= column1; ++column) {
+        visit((size_t)row * m_columns + column);
+      }
+    }
+  };
+
+  // Count, then fill, so the whole grid is two flat arrays
+  size_t cells = (size_t)m_columns * m_rows;
+  m_cellStart.assign(cells + 1, 0);
+  for (const Rect& rect : rects) {
+    forEachCell(rect, [this](size_t cell) { m_cellStart[cell + 1]++; });
+  }
+  for (size_t cell = 0; cell < cells; ++cell) {
+    m_cellStart[cell + 1] += m_cellStart[cell];
+  }
+
+  m_items.resize(m_cellStart[cells]);
+  std::vector<uint32_t> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+  for (size_t i = 0; i < rects.size(); ++i) {
+    forEachCell(rects[i], [&](size_t cell) { m_items[fill[cell]++] = i; });
+  }
+}
+
+} // namespace InWM
@@ -0,0 +1,52 @@
+#ifndef INWM_HITGRID_HPP
+#define INWM_HITGRID_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace InWM {
+
+struct Rect;
+
+// Uniform grid over a container's children, so finding the child under the
+// pointer only looks at the few that overlap one cell instead of all of them.
+//
+// The cell size follows the average child size, which keeps the number of
+// candidates per cell roughly constant however many children there are.
+class HitGrid {
+  public:
+    // Index rects[i] as item i. Later items are on top.
+    void build(const std::vector<Rect>& rects);
+    void clear();
+
+    // Topmost item covering (x, y) for which `accept(i)` is true, or -1
+    template<typename Accept>
+    int find(int x, int y, Accept accept) const {
+      if (m_columns == 0 || x < m_left || y < m_top) return -1;
+
+      int column = (x - m_left) / m_cellSize;
+      int row = (y - m_top) / m_cellSize;
+      if (column >= m_columns || row >= m_rows) return -1;
+
+      // Items go into each cell in index order
+      size_t cell = (size_t)row * m_columns + column;
+      for (uint32_t i = m_cellStart[cell + 1]; i > m_cellStart[cell]; --i) {
+        if (accept(m_items[i - 1])) return m_items[i - 1];
+      }
+      return -1;
+    }
+
+  private:
+    int m_left = 0, m_top = 0;
+    int m_cellSize = 1;
+    int m_columns = 0, m_rows = 0;
+
+    // Items of cell c are m_items[m_cellStart[c] .. m_cellStart[c + 1])
+    std::vector<uint32_t> m_cellStart;
+    std::vector<uint32_t> m_items;
+};
+
+} // namespace InWM
+
+#endif
@@ -0,0 +1,156 @@
+#include "Raster.hpp"
+#include "Font.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace InWM {
+
+namespace {
+
+void fillSpan(uint32_t* dst, int count, uint32_t color) {
+#if defined(__SSE2__)
+  __m128i pixels = _mm_set1_epi32((int)color);
+  for (; count >= 16; count -= 16, dst += 16) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), pixels);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4), pixels);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8), pixels);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 12), pixels);
+  }
+  for (; count >= 4; count -= 4, dst += 4) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), pixels);
+  }
+#endif
+  for (; count > 0; --count) {
+    *dst++ = color;
+  }
+}
+
+// Set the pixels whose coverage byte is 0xFF
+void blendSpan(uint32_t* dst, const uint8_t* mask, int count, uint32_t color) {
+#if defined(__SSE2__)
+  __m128i pixels = _mm_set1_epi32((int)color);
+  for (; count >= 4; count -= 4, dst += 4, mask += 4) {
+    uint32_t bytes;
+    memcpy(&bytes, mask, 4);
+    if (bytes == 0) continue;
+
+    // Widen each byte to a whole pixel of ones or zeros
+    __m128i select = _mm_cvtsi32_si128((int)bytes);
+    select = _mm_unpacklo_epi8(select, select);
+    select = _mm_unpacklo_epi16(select, select);
+    __m128i old = _mm_loadu_si128(reinterpret_cast<__m128i*>(dst));
+    __m128i blended = _mm_or_si128(_mm_and_si128(select, pixels), _mm_andnot_si128(select, old));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), blended);
+  }
+#endif
+  for (int i = 0; i < count; ++i) {
+    if (mask[i]) dst[i] = color;
+  }
+}
+
+Rect intersect(const Rect& a, const Rect& b) {
+  int left = std::max(a.x, b.x);
+  int top = std::max(a.y, b.y);
+  int right = std::min(a.x + a.width, b.x + b.width);
+  int bottom = std::min(a.y + a.height, b.y + b.height);
+  return Rect(left, top, std::max(0, right - left), std::max(0, bottom - top));
+}
+
+}
+
+void Raster::setBuffer(uint32_t* pixels, int width, int height, int stride) {
+  m_pixels = pixels;
+  m_width = width;
+  m_height = height;
+  m_stride = stride;
+  m_clip = Rect(0, 0, width, height);
+}
+
+void Raster::setClip(const Rect& clip) {
+  m_clip = intersect(clip, Rect(0, 0, m_width, m_height));
+}
+
+void Raster::fillRect(uint32_t color, const Rect& rect) {
+  Rect area = intersect(rect, m_clip);
+  if (area.isEmpty()) return;
+
+  uint32_t* row = m_pixels + area.y * m_stride + area.x;
+  for (int y = 0; y < area.height; ++y, row += m_stride) {
+    fillSpan(row, area.width, color);
+  }
+}
+
+void Raster::drawLine(uint32_t color, int x1, int y1, int x2, int y2) {
+  // Widgets only draw straight ones, which are just thin rectangles
+  if (y1 == y2) {
+    fillRect(color, Rect(std::min(x1, x2), y1, std::abs(x2 - x1) + 1, 1));
+    return;
+  }
+  if (x1 == x2) {
+    fillRect(color, Rect(x1, std::min(y1, y2), 1, std::abs(y2 - y1) + 1));
+    return;
+  }
+
+  // Bresenham, clipping pixel by pixel
+  int dx = std::abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+  int dy = -std::abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+  int error = dx + dy;
+  for (;;) {
+    if (m_clip.contains(x1, y1)) {
+      m_pixels[y1 * m_stride + x1] = color;
+    }
+    if (x1 == x2 && y1 == y2) break;
+    int twice = 2 * error;
+    if (twice >= dy) { error += dy; x1 += sx; }
+    if (twice <= dx) { error += dx; y1 += sy; }
+  }
+}
+
+void Raster::drawText(uint32_t color, int x, int y, const char* text, size_t length, Font& font) {
+  int cellWidth = font.getGlyphWidth();
+  int cellHeight = font.getHeight();
+  int top = y - font.getAscent();
+  if (top >= m_clip.y + m_clip.height || top + cellHeight <= m_clip.y) return;
+
+  int penX = x - font.getGlyphOriginX();
+  for (size_t i = 0; i < length; ++i) {
+    unsigned char c = text[i];
+    Rect cell(penX, top, cellWidth, cellHeight);
+    penX += font.charWidth(c);
+
+    Rect area = intersect(cell, m_clip);
+    if (area.isEmpty()) continue;
+
+    const uint8_t* mask = font.getGlyph(c) + (area.y - top) * cellWidth + (area.x - cell.x);
+    uint32_t* row = m_pixels + area.y * m_stride + area.x;
+    for (int line = 0; line < area.height; ++line, row += m_stride, mask += cellWidth) {
+      blendSpan(row, mask, area.width, color);
+    }
+  }
+}
+
+void RasterDrawContext::fillRect(unsigned long color, const Rect& rect) {
+  m_raster.fillRect(color, rect);
+}
+
+void RasterDrawContext::drawLine(unsigned long color, int x1, int y1, int x2, int y2) {
+  m_raster.drawLine(color, x1, y1, x2, y2);
+}
+
+void RasterDrawContext::drawRect(unsigned long color, const Rect& rect) {
+  if (rect.isEmpty()) return;
+  m_raster.fillRect(color, Rect(rect.x, rect.y, rect.width, 1));
+  m_raster.fillRect(color, Rect(rect.x, rect.y + rect.height - 1, rect.width, 1));
+  m_raster.fillRect(color, Rect(rect.x, rect.y, 1, rect.height));
+  m_raster.fillRect(color, Rect(rect.x + rect.width - 1, rect.y, 1, rect.height));
+}
+
+void RasterDrawContext::drawText(unsigned long color, int x, int y, const char* text, size_t length) {
+  m_raster.drawText(color, x, y, text, length, *m_font);
+}
+
+} // namespace InWM
@@ -0,0 +1,58 @@
+#ifndef INWM_RASTER_HPP
+#define INWM_RASTER_HPP
+
+#include "DrawContext.hpp"
+#include <cstdint>
+
+namespace InWM {
+
+// Widget primitives drawn straight into 32-bit 0xRRGGBB pixels in client
+// memory. Spans and glyphs are written four pixels at a time with SSE2
+// where the compiler targets it.
+class Raster {
+  public:
+    // Draw into `pixels`, `stride` pixels per row. The memory stays the
+    // caller's; the clip is reset to the whole buffer.
+    void setBuffer(uint32_t* pixels, int width, int height, int stride);
+
+    uint32_t* getPixels() const { return m_pixels; }
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    int getStride() const { return m_stride; }
+
+    // Nothing outside `clip` (and the buffer) is touched
+    void setClip(const Rect& clip);
+
+    void fillRect(uint32_t color, const Rect& rect);
+    void drawLine(uint32_t color, int x1, int y1, int x2, int y2);
+
+    // `y` is the baseline
+    void drawText(uint32_t color, int x, int y, const char* text, size_t length, Font& font);
+
+  private:
+    uint32_t* m_pixels = nullptr;
+    int m_width = 0, m_height = 0;
+    int m_stride = 0;
+    Rect m_clip;
+};
+
+// Hands a paint's primitives to a Raster. Nothing is queued, so flush()
+// has nothing to do.
+class RasterDrawContext : public DrawContext {
+  public:
+    RasterDrawContext(Display* dpy, Font* font, Raster& raster)
+    : DrawContext(dpy, font), m_raster(raster) {}
+
+    void fillRect(unsigned long color, const Rect& rect) override;
+    void drawLine(unsigned long color, int x1, int y1, int x2, int y2) override;
+    void drawRect(unsigned long color, const Rect& rect) override;
+    using DrawContext::drawText;
+    void drawText(unsigned long color, int x, int y, const char* text, size_t length) override;
+
+  private:
+    Raster& m_raster;
+};
+
+} // namespace InWM
+
+#endif
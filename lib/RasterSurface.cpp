@@ -0,0 +1,153 @@
+#include "RasterSurface.hpp"
+#include <cstdlib>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+namespace InWM {
+
+namespace {
+
+// XShmAttach fails asynchronously, e.g. when the server is remote
+bool s_attachFailed = false;
+
+int onAttachError(Display*, XErrorEvent*) {
+  s_attachFailed = true;
+  return 0;
+}
+
+}
+
+RasterSurface::RasterSurface(Display* dpy) : m_dpy(dpy) {}
+
+RasterSurface::~RasterSurface() {
+  release();
+}
+
+bool RasterSurface::isSupported(Display* dpy) {
+  int screen = DefaultScreen(dpy);
+  Visual* visual = DefaultVisual(dpy, screen);
+  int depth = DefaultDepth(dpy, screen);
+  if (depth < 24 || visual->red_mask != 0xFF0000 || visual->green_mask != 0x00FF00 ||
+      visual->blue_mask != 0x0000FF) {
+    return false;
+  }
+
+  // Images of that depth must have a whole 32-bit word per pixel
+  int count = 0;
+  bool wordPerPixel = false;
+  XPixmapFormatValues* formats = XListPixmapFormats(dpy, &count);
+  for (int i = 0; i < count; ++i) {
+    if (formats[i].depth == depth) wordPerPixel = formats[i].bits_per_pixel == 32;
+  }
+  if (formats) XFree(formats);
+  return wordPerPixel;
+}
+
+void RasterSurface::resize(int width, int height) {
+  if (width == m_width && height == m_height && m_raster.getPixels()) return;
+  release();
+  m_width = width;
+  m_height = height;
+  if (width <= 0 || height <= 0) return;
+
+  if (!m_dpy) {
+    m_memory.assign((size_t)width * height, 0);
+    m_raster.setBuffer(m_memory.data(), width, height, width);
+    return;
+  }
+  if (!createShared(width, height)) {
+    int screen = DefaultScreen(m_dpy);
+    char* data = static_cast<char*>(calloc((size_t)width * height, 4));
+    m_image = XCreateImage(m_dpy, DefaultVisual(m_dpy, screen), DefaultDepth(m_dpy, screen),
+                           ZPixmap, 0, data, width, height, 32, width * 4);
+    if (!m_image) {
+      free(data);
+      return;
+    }
+  }
+  m_raster.setBuffer(reinterpret_cast<uint32_t*>(m_image->data), width, height,
+                     m_image->bytes_per_line / 4);
+}
+
+bool RasterSurface::createShared(int width, int height) {
+  if (!XShmQueryExtension(m_dpy)) return false;
+
+  int screen = DefaultScreen(m_dpy);
+  m_image = XShmCreateImage(m_dpy, DefaultVisual(m_dpy, screen), DefaultDepth(m_dpy, screen),
+                            ZPixmap, nullptr, &m_shmInfo, width, height);
+  if (!m_image) return false;
+
+  m_shmInfo.shmid = shmget(IPC_PRIVATE, m_image->bytes_per_line * height, IPC_CREAT | 0600);
+  if (m_shmInfo.shmid < 0) {
+    XDestroyImage(m_image);
+    m_image = nullptr;
+    return false;
+  }
+  m_shmInfo.shmaddr = m_image->data = static_cast<char*>(shmat(m_shmInfo.shmid, nullptr, 0));
+  m_shmInfo.readOnly = False;
+  if (m_shmInfo.shmaddr == reinterpret_cast<char*>(-1)) {
+    shmctl(m_shmInfo.shmid, IPC_RMID, nullptr);
+    m_image->data = nullptr;
+    XDestroyImage(m_image);
+    m_image = nullptr;
+    return false;
+  }
+
+  XSync(m_dpy, False);
+  s_attachFailed = false;
+  XErrorHandler previous = XSetErrorHandler(onAttachError);
+  XShmAttach(m_dpy, &m_shmInfo);
+  XSync(m_dpy, False);
+  XSetErrorHandler(previous);
+
+  // Gone once both sides have detached, even if we crash
+  shmctl(m_shmInfo.shmid, IPC_RMID, nullptr);
+
+  if (s_attachFailed) {
+    shmdt(m_shmInfo.shmaddr);
+    m_image->data = nullptr;
+    XDestroyImage(m_image);
+    m_image = nullptr;
+    return false;
+  }
+  m_shared = true;
+  return true;
+}
+
+void RasterSurface::release() {
+  m_raster.setBuffer(nullptr, 0, 0, 0);
+  m_memory = std::vector<uint32_t>();
+  if (!m_image) return;
+  waitForPut();
+  if (m_shared) {
+    XShmDetach(m_dpy, &m_shmInfo);
+    shmdt(m_shmInfo.shmaddr);
+    m_image->data = nullptr;
+    m_shared = false;
+  }
+  XDestroyImage(m_image);
+  m_image = nullptr;
+}
+
+void RasterSurface::waitForPut() {
+  // One round trip, and only if the server may still be reading
+  if (m_putPending) {
+    XSync(m_dpy, False);
+    m_putPending = false;
+  }
+}
+
+void RasterSurface::put(Drawable drawable, GC gc, const Rect& rect) {
+  if (!m_image || rect.isEmpty()) return;
+  if (m_shared) {
+    XShmPutImage(m_dpy, drawable, gc, m_image, rect.x, rect.y, rect.x, rect.y,
+                 rect.width, rect.height, False);
+    m_putPending = true;
+  } else {
+    // Xlib copies the pixels into the request, so the memory is free again
+    XPutImage(m_dpy, drawable, gc, m_image, rect.x, rect.y, rect.x, rect.y,
+              rect.width, rect.height);
+  }
+}
+
+} // namespace InWM
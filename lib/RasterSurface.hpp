@@ -0,0 +1,59 @@
+#ifndef INWM_RASTERSURFACE_HPP
+#define INWM_RASTERSURFACE_HPP
+
+#include "Raster.hpp"
+#include <vector>
+extern "C" {
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+}
+
+namespace InWM {
+
+// Client-side pixels for a window. Areas are put on screen with
+// XShmPutImage when the server can map our memory (MIT-SHM, local
+// connections), and with XPutImage otherwise. Without a display (nullptr)
+// the pixels only live in memory and put() does nothing.
+class RasterSurface {
+  public:
+    explicit RasterSurface(Display* dpy);
+    ~RasterSurface();
+
+    RasterSurface(const RasterSurface&) = delete;
+    RasterSurface& operator=(const RasterSurface&) = delete;
+
+    // Whether the default visual stores pixels as 32-bit 0xRRGGBB, which is
+    // what Raster draws
+    static bool isSupported(Display* dpy);
+
+    // Reallocate for a new size; the contents are undefined afterwards
+    void resize(int width, int height);
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    bool isShared() const { return m_shared; }
+
+    // Draw through this. Call waitForPut() first, the server may still be
+    // reading the memory.
+    Raster& getRaster() { return m_raster; }
+    void waitForPut();
+
+    // Copy `rect` of the pixels to the same place in `drawable`
+    void put(Drawable drawable, GC gc, const Rect& rect);
+
+  private:
+    void release();
+    bool createShared(int width, int height);
+
+    Display* m_dpy;
+    XImage* m_image = nullptr;
+    std::vector<uint32_t> m_memory;   // Instead of m_image without a display
+    XShmSegmentInfo m_shmInfo;
+    bool m_shared = false;
+    bool m_putPending = false;
+    int m_width = 0, m_height = 0;
+    Raster m_raster;
+};
+
+} // namespace InWM
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef INWM_SMALLFUNCTION_HPP
+#define INWM_SMALLFUNCTION_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace InWM {
+
+// std::function without the allocation for typical callbacks: callables up
+// to four pointers in size (e.g. a lambda capturing `this` and a couple of
+// references) live inside the object; only bigger ones go on the heap.
+// Like std::function it is copyable, so the callable must be too.
+template<typename Signature>
+class SmallFunction;
+
+template<typename R, typename... Args>
+class SmallFunction<R(Args...)> {
+  public:
+    static const size_t INLINE_SIZE = 4 * sizeof(void*);
+
+    SmallFunction() noexcept : m_invoke(nullptr), m_ops(nullptr) {}
+    SmallFunction(std::nullptr_t) noexcept : m_invoke(nullptr), m_ops(nullptr) {}
+
+    template<typename F,
+             typename = std::enable_if_t<!std::is_same<std::decay_t<F>, SmallFunction>::value>>
+    SmallFunction(F&& f) : m_invoke(nullptr), m_ops(nullptr) {
+      using Callable = std::decay_t<F>;
+      if constexpr (isInline<Callable>()) {
+        new (m_storage) Callable(std::forward<F>(f));
+      } else {
+        new (m_storage) Callable*(new Callable(std::forward<F>(f)));
+      }
+      m_ops = &ops<Callable>();
+      m_invoke = m_ops->invoke;
+    }
+
+    SmallFunction(const SmallFunction& other) : m_invoke(other.m_invoke), m_ops(other.m_ops) {
+      if (m_ops) m_ops->copy(other.m_storage, m_storage);
+    }
+
+    SmallFunction(SmallFunction&& other) noexcept : m_invoke(other.m_invoke), m_ops(other.m_ops) {
+      if (m_ops) {
+        m_ops->move(other.m_storage, m_storage);
+        other.m_invoke = nullptr;
+        other.m_ops = nullptr;
+      }
+    }
+
+    ~SmallFunction() { reset(); }
+
+    SmallFunction& operator=(const SmallFunction& other) {
+      if (this != &other) {
+        SmallFunction copy(other);
+        *this = std::move(copy);
+      }
+      return *this;
+    }
+
+    SmallFunction& operator=(SmallFunction&& other) noexcept {
+      if (this != &other) {
+        reset();
+        m_invoke = other.m_invoke;
+        m_ops = other.m_ops;
+        if (m_ops) {
+          m_ops->move(other.m_storage, m_storage);
+          other.m_invoke = nullptr;
+          other.m_ops = nullptr;
+        }
+      }
+      return *this;
+    }
+
+    SmallFunction& operator=(std::nullptr_t) noexcept {
+      reset();
+      return *this;
+    }
+
+    explicit operator bool() const { return m_ops != nullptr; }
+
+    R operator()(Args... args) const {
+      return m_invoke(const_cast<unsigned char*>(m_storage), std::forward<Args>(args)...);
+    }
+
+  private:
+    using Invoke = R (*)(void* storage, Args&&... args);
+
+    struct Ops {
+      Invoke invoke;
+      void (*copy)(const void* from, void* to);
+      void (*move)(void* from, void* to);     // Leaves `from` destroyed
+      void (*destroy)(void* storage);
+    };
+
+    template<typename Callable>
+    static constexpr bool isInline() {
+      return sizeof(Callable) <= INLINE_SIZE &&
+             alignof(Callable) <= alignof(std::max_align_t) &&
+             std::is_nothrow_move_constructible<Callable>::value;
+    }
+
+    template<typename Callable>
+    static Callable& target(void* storage) {
+      if constexpr (isInline<Callable>()) {
+        return *static_cast<Callable*>(storage);
+      } else {
+        return **static_cast<Callable**>(storage);
+      }
+    }
+
+    template<typename Callable>
+    static const Ops& ops() {
+      static const Ops table = {
+        [](void* storage, Args&&... args) -> R {
+          return target<Callable>(storage)(std::forward<Args>(args)...);
+        },
+        [](const void* from, void* to) {
+          const Callable& callable = target<Callable>(const_cast<void*>(from));
+          if constexpr (isInline<Callable>()) {
+            new (to) Callable(callable);
+          } else {
+            new (to) Callable*(new Callable(callable));
+          }
+        },
+        [](void* from, void* to) {
+          if constexpr (isInline<Callable>()) {
+            Callable& callable = *static_cast<Callable*>(from);
+            new (to) Callable(std::move(callable));
+            callable.~Callable();
+          } else {
+            // Just hand over the heap copy
+            new (to) Callable*(*static_cast<Callable**>(from));
+          }
+        },
+        [](void* storage) {
+          if constexpr (isInline<Callable>()) {
+            static_cast<Callable*>(storage)->~Callable();
+          } else {
+            delete *static_cast<Callable**>(storage);
+          }
+        }
+      };
+      return table;
+    }
+
+    void reset() {
+      if (m_ops) {
+        m_ops->destroy(m_storage);
+        m_invoke = nullptr;
+        m_ops = nullptr;
+      }
+    }
+
+    alignas(std::max_align_t) unsigned char m_storage[INLINE_SIZE];
+    Invoke m_invoke;      // Copied out of m_ops to save a load per call
+    const Ops* m_ops;
+};
+
+} // namespace InWM
+
+#endif
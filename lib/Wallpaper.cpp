@@ -0,0 +1,405 @@
+#include "Wallpaper.hpp"
+#include "WorkerPool.hpp"
+extern "C" {
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+}
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace InWM {
+
+namespace {
+
+// Streaming image source. Rows are produced top to bottom as 0x00RRGGBB.
+class ImageReader {
+  public:
+    virtual ~ImageReader() = default;
+    virtual bool readHeader(FILE* file) = 0;
+    virtual bool readRow(uint32_t* row) = 0;
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+  protected:
+    FILE* m_file = nullptr;
+    int m_width = 0;
+    int m_height = 0;
+};
+
+// Binary PPM (P6), 8 or 16 bits per channel
+class PpmReader : public ImageReader {
+  public:
+    bool readHeader(FILE* file) override {
+      m_file = file;
+      if (fgetc(file) != 'P' || fgetc(file) != '6') return false;
+
+      if (!readNumber(m_width) || !readNumber(m_height) || !readNumber(m_maxval)) {
+        return false;
+      }
+      if (m_width <= 0 || m_height <= 0 || m_maxval <= 0 || m_maxval > 65535) {
+        return false;
+      }
+
+      // Exactly one whitespace byte separates the header from the samples
+      fgetc(file);
+      m_bytesPerSample = m_maxval > 255 ? 2 : 1;
+      m_buffer.resize((size_t)m_width * 3 * m_bytesPerSample);
+      return true;
+    }
+
+    bool readRow(uint32_t* row) override {
+      if (fread(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size()) {
+        return false;
+      }
+
+      const unsigned char* p = m_buffer.data();
+      for (int x = 0; x < m_width; ++x) {
+        uint32_t rgb[3];
+        for (int c = 0; c < 3; ++c) {
+          uint32_t v = *p++;
+          if (m_bytesPerSample == 2) v = (v << 8) | *p++;
+          rgb[c] = m_maxval == 255 ? v : v * 255 / m_maxval;
+        }
+        row[x] = (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+      }
+      return true;
+    }
+
+  private:
+    bool readNumber(int& value) {
+      int c = fgetc(m_file);
+
+      // Skip whitespace and comments
+      while (c == '#' || c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        if (c == '#') {
+          while (c != '\n' && c != EOF) c = fgetc(m_file);
+        }
+        c = fgetc(m_file);
+      }
+
+      if (c < '0' || c > '9') return false;
+
+      value = 0;
+      while (c >= '0' && c <= '9') {
+        value = value * 10 + (c - '0');
+        if (value > (1 << 24)) return false;
+        c = fgetc(m_file);
+      }
+      ungetc(c, m_file);
+      return true;
+    }
+
+    int m_maxval = 255;
+    int m_bytesPerSample = 1;
+    std::vector<unsigned char> m_buffer;
+};
+
+// "Quite OK Image" format, see https://qoiformat.org/qoi-specification.pdf
+class QoiReader : public ImageReader {
+  public:
+    bool readHeader(FILE* file) override {
+      m_file = file;
+
+      unsigned char header[14];
+      if (fread(header, 1, sizeof(header), file) != sizeof(header)) return false;
+      if (memcmp(header, "qoif", 4) != 0) return false;
+
+      uint32_t width = readBE32(header + 4);
+      uint32_t height = readBE32(header + 8);
+      if (width == 0 || height == 0 || width > (1 << 16) || height > (1 << 16)) {
+        return false;
+      }
+
+      m_width = width;
+      m_height = height;
+      return true;
+    }
+
+    bool readRow(uint32_t* row) override {
+      for (int x = 0; x < m_width; ++x) {
+        if (m_run > 0) {
+          m_run--;
+        } else if (!decodePixel()) {
+          return false;
+        }
+        row[x] = (m_px[0] << 16) | (m_px[1] << 8) | m_px[2];
+      }
+      return true;
+    }
+
+  private:
+    static uint32_t readBE32(const unsigned char* p) {
+      return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    bool decodePixel() {
+      int op = fgetc(m_file);
+      if (op == EOF) return false;
+
+      if (op == 0xFE) {        // QOI_OP_RGB
+        for (int c = 0; c < 3; ++c) m_px[c] = fgetc(m_file);
+      } else if (op == 0xFF) { // QOI_OP_RGBA
+        for (int c = 0; c < 4; ++c) m_px[c] = fgetc(m_file);
+      } else {
+        switch (op >> 6) {
+          case 0: // QOI_OP_INDEX
+            memcpy(m_px, m_index[op], sizeof(m_px));
+            break;
+          case 1: // QOI_OP_DIFF
+            m_px[0] += ((op >> 4) & 3) - 2;
+            m_px[1] += ((op >> 2) & 3) - 2;
+            m_px[2] += (op & 3) - 2;
+            break;
+          case 2: { // QOI_OP_LUMA
+            int next = fgetc(m_file);
+            int dg = (op & 0x3F) - 32;
+            m_px[0] += dg - 8 + ((next >> 4) & 0x0F);
+            m_px[1] += dg;
+            m_px[2] += dg - 8 + (next & 0x0F);
+            break;
+          }
+          case 3: // QOI_OP_RUN, this pixel plus `run` more
+            m_run = op & 0x3F;
+            break;
+        }
+      }
+
+      if (ferror(m_file) || feof(m_file)) return false;
+
+      int hash = (m_px[0] * 3 + m_px[1] * 5 + m_px[2] * 7 + m_px[3] * 11) % 64;
+      memcpy(m_index[hash], m_px, sizeof(m_px));
+      return true;
+    }
+
+    unsigned char m_px[4] = { 0, 0, 0, 255 };
+    unsigned char m_index[64][4] = {};
+    int m_run = 0;
+};
+
+std::unique_ptr<ImageReader> openImage(FILE* file) {
+  unsigned char magic[4] = {};
+  size_t n = fread(magic, 1, sizeof(magic), file);
+  rewind(file);
+
+  std::unique_ptr<ImageReader> reader;
+  if (n >= 2 && magic[0] == 'P' && magic[1] == '6') {
+    reader.reset(new PpmReader());
+  } else if (n == 4 && memcmp(magic, "qoif", 4) == 0) {
+    reader.reset(new QoiReader());
+  } else {
+    printf("Wallpaper: unsupported image format (use PPM or QOI)\n");
+    return nullptr;
+  }
+
+  if (!reader->readHeader(file)) {
+    printf("Wallpaper: malformed image header\n");
+    return nullptr;
+  }
+  return reader;
+}
+
+// Split [0, srcLength) into `count` consecutive spans starting at `offset`.
+// spans[i]..spans[i + 1] is the source range for destination index i.
+std::vector<int> makeSpans(int offset, int srcLength, int count) {
+  std::vector<int> spans(count + 1);
+  for (int i = 0; i <= count; ++i) {
+    spans[i] = offset + (int)((int64_t)i * srcLength / count);
+  }
+  return spans;
+}
+
+// Scale the decoded image to cover width x height (cropping the overflow),
+// consuming the source one row at a time.
+//
+// Downscaling averages every source pixel that falls into a destination
+// pixel; upscaling repeats the nearest source pixel.
+bool scaleToCover(ImageReader& reader, int width, int height, uint32_t* out) {
+  const int srcWidth = reader.width();
+  const int srcHeight = reader.height();
+
+  // Crop the source to the destination aspect ratio
+  int cropWidth = srcWidth;
+  int cropHeight = srcHeight;
+  if ((int64_t)srcWidth * height > (int64_t)srcHeight * width) {
+    cropWidth = std::max<int64_t>(1, (int64_t)srcHeight * width / height);
+  } else {
+    cropHeight = std::max<int64_t>(1, (int64_t)srcWidth * height / width);
+  }
+  const int cropX = (srcWidth - cropWidth) / 2;
+  const int cropY = (srcHeight - cropHeight) / 2;
+
+  const std::vector<int> cols = makeSpans(cropX, cropWidth, width);
+  const std::vector<int> rows = makeSpans(cropY, cropHeight, height);
+
+  std::vector<uint32_t> srcRow(srcWidth);
+  std::vector<uint32_t> acc((size_t)width * 3, 0);
+  int accRows = 0;
+  int dstY = 0;
+
+  for (int y = 0; y < srcHeight && dstY < height; ++y) {
+    if (!reader.readRow(srcRow.data())) return false;
+    if (y < rows[dstY]) continue;
+
+    // Horizontal pass straight into the vertical accumulator
+    for (int x = 0; x < width; ++x) {
+      const int begin = cols[x];
+      const int end = std::max(cols[x + 1], begin + 1);
+      uint32_t r = 0, g = 0, b = 0;
+      for (int sx = begin; sx < end; ++sx) {
+        const uint32_t px = srcRow[sx];
+        r += (px >> 16) & 0xFF;
+        g += (px >> 8) & 0xFF;
+        b += px & 0xFF;
+      }
+      const uint32_t n = end - begin;
+      acc[x * 3] += r / n;
+      acc[x * 3 + 1] += g / n;
+      acc[x * 3 + 2] += b / n;
+    }
+    accRows++;
+
+    // Still inside this destination row's span
+    if (y + 1 < std::max(rows[dstY + 1], rows[dstY] + 1)) continue;
+
+    uint32_t* dst = out + (size_t)dstY * width;
+    for (int x = 0; x < width; ++x) {
+      dst[x] = ((acc[x * 3] / accRows) << 16) |
+               ((acc[x * 3 + 1] / accRows) << 8) |
+               (acc[x * 3 + 2] / accRows);
+    }
+    std::fill(acc.begin(), acc.end(), 0);
+    accRows = 0;
+
+    // When upscaling, following rows map onto the same source row
+    for (dstY++; dstY < height && rows[dstY] <= y; dstY++) {
+      memcpy(out + (size_t)dstY * width, dst, width * sizeof(uint32_t));
+    }
+  }
+
+  return dstY == height;
+}
+
+// The pixmap in a root window property, or None if it isn't one
+Pixmap readPixmapProperty(Display* dpy, ::Window root, Atom property) {
+  Atom type;
+  int format;
+  unsigned long count, after;
+  unsigned char* data = nullptr;
+  Pixmap pixmap = None;
+  if (XGetWindowProperty(dpy, root, property, 0, 1, False, XA_PIXMAP,
+                         &type, &format, &count, &after, &data) == Success && data) {
+    if (type == XA_PIXMAP && format == 32 && count == 1) {
+      pixmap = *reinterpret_cast<Pixmap*>(data);
+    }
+    XFree(data);
+  }
+  return pixmap;
+}
+
+// Hand the pixmap to the root window the way other wallpaper setters do, so
+// compositors and pseudo-transparent clients can find it.
+void publishRootPixmap(Display* dpy, ::Window root, Pixmap pixmap) {
+  Atom rootPmap = XInternAtom(dpy, "_XROOTPMAP_ID", False);
+  Atom esetrootPmap = XInternAtom(dpy, "ESETROOT_PMAP_ID", False);
+
+  // Free the retained resources of whoever set the previous wallpaper. Like
+  // Esetroot and feh, only when both properties still name the same pixmap:
+  // a stale ESETROOT_PMAP_ID may by now belong to an unrelated client.
+  Pixmap previous = readPixmapProperty(dpy, root, esetrootPmap);
+  if (previous != None && previous == readPixmapProperty(dpy, root, rootPmap)) {
+    XKillClient(dpy, previous);
+  }
+
+  XChangeProperty(dpy, root, rootPmap, XA_PIXMAP, 32, PropModeReplace,
+                  (unsigned char*)&pixmap, 1);
+  XChangeProperty(dpy, root, esetrootPmap, XA_PIXMAP, 32, PropModeReplace,
+                  (unsigned char*)&pixmap, 1);
+  XSetWindowBackgroundPixmap(dpy, root, pixmap);
+  XClearWindow(dpy, root);
+}
+
+} // namespace
+
+void Wallpaper::loadAsync(const std::string& path, ::Window target) {
+  WorkerPool::shared().submit([path, target]() -> WorkerPool::Completion {
+    load(path, target);
+    return nullptr;
+  });
+}
+
+bool Wallpaper::load(const std::string& path, ::Window target) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    printf("Wallpaper: cannot open %s\n", path.c_str());
+    return false;
+  }
+
+  std::unique_ptr<ImageReader> reader = openImage(file);
+  if (!reader) {
+    fclose(file);
+    return false;
+  }
+
+  Display* dpy = XOpenDisplay(nullptr);
+  if (!dpy) {
+    fclose(file);
+    return false;
+  }
+
+  int screen = DefaultScreen(dpy);
+  int width = DisplayWidth(dpy, screen);
+  int height = DisplayHeight(dpy, screen);
+  int depth = DefaultDepth(dpy, screen);
+  Visual* visual = DefaultVisual(dpy, screen);
+
+  if (depth < 24 || visual->red_mask != 0xFF0000 || visual->blue_mask != 0x0000FF) {
+    printf("Wallpaper: need a 24-bit TrueColor visual\n");
+    XCloseDisplay(dpy);
+    fclose(file);
+    return false;
+  }
+
+  std::vector<uint32_t> pixels((size_t)width * height);
+  bool ok = scaleToCover(*reader, width, height, pixels.data());
+  fclose(file);
+
+  if (!ok) {
+    printf("Wallpaper: failed to decode %s\n", path.c_str());
+    XCloseDisplay(dpy);
+    return false;
+  }
+
+  // Keep the pixmap alive after this connection closes
+  XSetCloseDownMode(dpy, RetainPermanent);
+
+  ::Window root = RootWindow(dpy, screen);
+  Pixmap pixmap = XCreatePixmap(dpy, root, width, height, depth);
+  XImage* image = XCreateImage(dpy, visual, depth, ZPixmap, 0,
+                               reinterpret_cast<char*>(pixels.data()),
+                               width, height, 32, 0);
+  GC gc = XCreateGC(dpy, pixmap, 0, nullptr);
+  XPutImage(dpy, pixmap, gc, image, 0, 0, 0, 0, width, height);
+  XFreeGC(dpy, gc);
+
+  // The pixel buffer belongs to the vector
+  image->data = nullptr;
+  XDestroyImage(image);
+
+  publishRootPixmap(dpy, root, pixmap);
+
+  if (target != None) {
+    XSetWindowBackgroundPixmap(dpy, target, pixmap);
+    XClearArea(dpy, target, 0, 0, 0, 0, True);
+  }
+
+  XCloseDisplay(dpy);
+  printf("Wallpaper: loaded %s (%dx%d)\n", path.c_str(), reader->width(), reader->height());
+  return true;
+}
+
+} // namespace InWM
@@ -0,0 +1,33 @@
+#ifndef INWM_WALLPAPER_HPP
+#define INWM_WALLPAPER_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <string>
+
+namespace InWM {
+
+// Desktop wallpaper loader.
+//
+// Images are decoded row by row and scaled to cover the screen while they
+// stream in, so only a couple of source rows and the screen-sized result are
+// ever held in memory, even for 8K photos. The result is uploaded once as a
+// pixmap that is published on the root window through _XROOTPMAP_ID.
+//
+// Supported formats: binary PPM (P6) and QOI.
+class Wallpaper {
+  public:
+    // Decode and install `path` on the shared WorkerPool so callers never
+    // block on it. `target` (e.g. a desktop window covering the root) gets
+    // the same pixmap as its window background.
+    static void loadAsync(const std::string& path, ::Window target = None);
+
+    // Synchronous version of loadAsync(). Uses its own display connection,
+    // so it is safe to call from any thread.
+    static bool load(const std::string& path, ::Window target = None);
+};
+
+} // namespace InWM
+
+#endif
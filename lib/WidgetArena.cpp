@@ -0,0 +1,36 @@
+#include "WidgetArena.hpp"
+#include <algorithm>
+#include <cstdint>
+
+namespace InWM {
+
+WidgetArena::WidgetArena(size_t blockSize) : m_blockSize(blockSize) {}
+
+WidgetArena::~WidgetArena() {
+  // Newest first, like locals going out of scope
+  for (Destructor* d = m_destructors; d; d = d->m_next) {
+    d->m_destroy(d->m_object);
+  }
+}
+
+void* WidgetArena::allocate(size_t size, size_t alignment) {
+  uintptr_t cursor = reinterpret_cast<uintptr_t>(m_cursor);
+  uintptr_t aligned = (cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+
+  if (!m_cursor || aligned + size > reinterpret_cast<uintptr_t>(m_end)) {
+    // Oversized requests get a block of their own
+    size_t blockSize = std::max(m_blockSize, size + alignment);
+    m_blocks.emplace_back(new char[blockSize]);
+    m_cursor = m_blocks.back().get();
+    m_end = m_cursor + blockSize;
+
+    cursor = reinterpret_cast<uintptr_t>(m_cursor);
+    aligned = (cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  }
+
+  m_cursor = reinterpret_cast<char*>(aligned + size);
+  m_bytesUsed += size;
+  return reinterpret_cast<void*>(aligned);
+}
+
+} // namespace InWM
@@ -0,0 +1,68 @@
+#ifndef INWM_WIDGETARENA_HPP
+#define INWM_WIDGETARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace InWM {
+
+// Bump allocator for a window's widget tree. Objects are carved out of large
+// blocks one after the other and all destroyed together (newest first) when
+// the arena goes away, so building and tearing down a big form costs a
+// handful of allocations instead of one or more per widget.
+//
+// Objects cannot be freed individually. Use it for widgets that live as long
+// as their window; see Window::create().
+class WidgetArena {
+  public:
+    explicit WidgetArena(size_t blockSize = 64 * 1024);
+    ~WidgetArena();
+
+    WidgetArena(const WidgetArena&) = delete;
+    WidgetArena& operator=(const WidgetArena&) = delete;
+
+    template<typename T, typename... Args>
+    T* create(Args&&... args) {
+      if constexpr (std::is_trivially_destructible<T>::value) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+      } else {
+        // The destructor record goes right in front of the object
+        size_t offset = (sizeof(Destructor) + alignof(T) - 1) / alignof(T) * alignof(T);
+        char* memory = static_cast<char*>(allocate(offset + sizeof(T),
+                                                   std::max(alignof(T), alignof(Destructor))));
+        T* object = new (memory + offset) T(std::forward<Args>(args)...);
+        m_destructors = new (memory) Destructor{ m_destructors, object,
+                                                 [](void* p) { static_cast<T*>(p)->~T(); } };
+        return object;
+      }
+    }
+
+    // Raw memory, freed with the arena
+    void* allocate(size_t size, size_t alignment);
+
+    size_t getBytesUsed() const { return m_bytesUsed; }
+    size_t getBlockCount() const { return m_blocks.size(); }
+
+  private:
+    struct Destructor {
+      Destructor* m_next;
+      void* m_object;
+      void (*m_destroy)(void*);
+    };
+
+    size_t m_blockSize;
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    char* m_cursor = nullptr;
+    char* m_end = nullptr;
+    size_t m_bytesUsed = 0;
+    Destructor* m_destructors = nullptr;   // Newest first
+};
+
+} // namespace InWM
+
+#endif
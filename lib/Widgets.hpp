@@ -3,10 +3,16 @@
 
 // Include all InWM GUI components
 #include "GUI.hpp"
+#include "DrawContext.hpp"
+#include "Font.hpp"
+#include "GCCache.hpp"
 #include "Application.hpp" 
 #include "Window.hpp"
 #include "Button.hpp"
 #include "Dropdown.hpp"
+#include "Wallpaper.hpp"
+#include "WorkerPool.hpp"
+#include "WindowState.hpp"
 
 // Convenience namespace for easier usage
 namespace InWM {
@@ -1,18 +1,31 @@
 #include "Window.hpp"
 #include "Application.hpp"
-#include "Dropdown.hpp"
+#include "RasterSurface.hpp"
 #include <algorithm>
 
 namespace InWM {
 
 Window::Window(Application* app, const std::string& title, int width, int height)
-    : Widget(app, nullptr), m_title(title) {
+    : Widget(app, nullptr), m_title(title), m_dirtyRegion(XCreateRegion()),
+      m_drawContext(app->getDisplay(), app->getFont()) {
     
     setBounds(Rect(100, 100, width, height)); // Default position
-    createXWindow();
+    if (app->isHeadless()) {
+        m_raster.reset(new RasterSurface(nullptr));
+    } else {
+        createXWindow();
+    }
 }
 
 Window::~Window() {
+    m_app->cancelPaint(this);
+    XDestroyRegion(m_dirtyRegion);
+    if (m_backBuffer != None) {
+        XFreePixmap(m_app->getDisplay(), m_backBuffer);
+    }
+    if (m_gc) {
+        XFreeGC(m_app->getDisplay(), m_gc);
+    }
     if (m_xwindow) {
         XDestroyWindow(m_app->getDisplay(), m_xwindow);
     }
@@ -47,36 +60,142 @@ void Window::createXWindow() {
     // Select events we want to receive
     XSelectInput(m_app->getDisplay(), m_xwindow, 
                 ExposureMask | ButtonPressMask | ButtonReleaseMask | 
-                PointerMotionMask | KeyPressMask | StructureNotifyMask);
+                PointerMotionMask | LeaveWindowMask | KeyPressMask | StructureNotifyMask);
+    
+    // Our own GC, since paint() sets a clip region on it; copies from the
+    // back-buffer never need GraphicsExpose
+    XGCValues values;
+    values.graphics_exposures = False;
+    unsigned long mask = GCGraphicsExposures;
+    if (m_app->getFont()->getId() != None) {
+        values.font = m_app->getFont()->getId();
+        mask |= GCFont;
+    }
+    m_gc = XCreateGC(m_app->getDisplay(), m_xwindow, mask, &values);
 }
 
-void Window::draw(Drawable drawable, GC gc) {
+void Window::draw(DrawContext& dc) {
     if (!m_visible) return;
     
-    // Clear background
     const Rect& bounds = getBounds();
-    XSetForeground(m_app->getDisplay(), gc, Colors::GRAY_LIGHT);
-    XFillRectangle(m_app->getDisplay(), drawable, gc, 0, 0, bounds.width, bounds.height);
+    drawArea(dc, Rect(0, 0, bounds.width, bounds.height));
+}
+
+void Window::drawArea(DrawContext& dc, const Rect& area) {
+    // Clear background (the server already tiled it if we have a pixmap)
+    if (m_backgroundPixmap == None) {
+        dc.fillRect(Colors::GRAY_LIGHT, area);
+    }
     
-    // Draw all non-dropdown children first, or closed dropdowns (just the title)
-    for (auto& child : getChildren()) {
-        if (child->isVisible()) {
-            auto dropdown = dynamic_cast<class Dropdown*>(child.get());
-            if (!dropdown || !dropdown->isOpen()) {
-                child->draw(drawable, gc);
+    // One pass per layer, bottom to top, so open menus end up on top
+    for (int layer = 0; layer < LAYER_COUNT; ++layer) {
+        for (Widget* child : getRenderList((Layer)layer)) {
+            if (child->isVisible() && child->getPaintBounds().intersects(area)) {
+                child->draw(dc);
             }
         }
     }
+}
+
+void Window::invalidate(const Rect& rect) {
+    if (rect.isEmpty()) return;
+    
+    XRectangle xrect = { (short)rect.x, (short)rect.y,
+                         (unsigned short)rect.width, (unsigned short)rect.height };
+    XUnionRectWithRegion(&xrect, m_dirtyRegion, m_dirtyRegion);
+    m_app->schedulePaint(this);
+}
+
+bool Window::needsPaint() const {
+    return m_visible && !XEmptyRegion(m_dirtyRegion);
+}
+
+void Window::paint() {
+    if (!needsPaint()) return;
+    
+    Display* display = m_app->getDisplay();
+    const Rect& bounds = getBounds();
     
-    // Draw open dropdown menus last (on top) 
-    for (auto& child : getChildren()) {
-        if (child->isVisible()) {
-            auto dropdown = dynamic_cast<class Dropdown*>(child.get());
-            if (dropdown && dropdown->isOpen()) {
-                child->draw(drawable, gc);
+    if (m_backgroundPixmap != None) {
+        // The server owns the background (it may be a wallpaper another
+        // client installed), so repaint the dirty box in place
+        XRectangle box;
+        XClipBox(m_dirtyRegion, &box);
+        XClearArea(display, m_xwindow, box.x, box.y, box.width, box.height, False);
+        
+        XSetClipRectangles(display, m_gc, 0, 0, &box, 1, Unsorted);
+        m_drawContext.begin(m_xwindow, m_gc);
+        drawArea(m_drawContext, Rect(box.x, box.y, box.width, box.height));
+        m_drawContext.flush();
+    } else if (m_raster) {
+        XRectangle box;
+        XClipBox(m_dirtyRegion, &box);
+        paintRaster(Rect(box.x, box.y, box.width, box.height));
+    } else {
+        // A new buffer starts out blank, so everything is dirty
+        if (m_backBuffer == None || m_bufferWidth != bounds.width || m_bufferHeight != bounds.height) {
+            if (m_backBuffer != None) {
+                XFreePixmap(display, m_backBuffer);
             }
+            m_bufferWidth = bounds.width;
+            m_bufferHeight = bounds.height;
+            m_backBuffer = XCreatePixmap(display, m_xwindow, m_bufferWidth, m_bufferHeight,
+                                         DefaultDepth(display, DefaultScreen(display)));
+            invalidate(Rect(0, 0, m_bufferWidth, m_bufferHeight));
         }
+        
+        XRectangle box;
+        XClipBox(m_dirtyRegion, &box);
+        
+        // Widgets outside the dirty region are skipped, and the clip keeps
+        // the ones that overlap it from touching anything else
+        XSetRegion(display, m_gc, m_dirtyRegion);
+        m_drawContext.begin(m_backBuffer, m_gc);
+        drawArea(m_drawContext, Rect(box.x, box.y, box.width, box.height));
+        m_drawContext.flush();
+        XCopyArea(display, m_backBuffer, m_xwindow, m_gc,
+                  box.x, box.y, box.width, box.height, box.x, box.y);
+    }
+    
+    if (m_gc) {
+        XSetClipMask(display, m_gc, None);
     }
+    XDestroyRegion(m_dirtyRegion);
+    m_dirtyRegion = XCreateRegion();
+}
+
+void Window::paintRaster(const Rect& area) {
+    const Rect& bounds = getBounds();
+    Rect box = area;
+    if (m_raster->getWidth() != bounds.width || m_raster->getHeight() != bounds.height) {
+        m_raster->resize(bounds.width, bounds.height);
+        box = Rect(0, 0, bounds.width, bounds.height);
+    }
+    
+    // Everything that touches the box is redrawn, so the whole box can go
+    // up; no need to clip to the exact region
+    m_raster->waitForPut();
+    Raster& raster = m_raster->getRaster();
+    raster.setClip(box);
+    RasterDrawContext dc(m_app->getDisplay(), m_app->getFont(), raster);
+    drawArea(dc, box);
+    m_raster->put(m_xwindow, m_gc, box);
+}
+
+bool Window::setRasterRendering(bool enabled) {
+    if (enabled == (m_raster != nullptr)) return true;
+    if (m_app->isHeadless()) return false;
+    if (enabled && !RasterSurface::isSupported(m_app->getDisplay())) return false;
+    
+    m_raster.reset(enabled ? new RasterSurface(m_app->getDisplay()) : nullptr);
+    const Rect& bounds = getBounds();
+    invalidate(Rect(0, 0, bounds.width, bounds.height));
+    return true;
+}
+
+const Raster* Window::getRaster() const {
+    if (!m_raster || !m_raster->getRaster().getPixels()) return nullptr;
+    return &m_raster->getRaster();
 }
 
 void Window::handleEvent(const Event& event) {
@@ -85,7 +204,9 @@ void Window::handleEvent(const Event& event) {
 
 void Window::show() {
     if (!m_visible) {
-        XMapWindow(m_app->getDisplay(), m_xwindow);
+        if (m_xwindow) {
+            XMapWindow(m_app->getDisplay(), m_xwindow);
+        }
         m_visible = true;
         setVisible(true);
     }
@@ -93,7 +214,9 @@ void Window::show() {
 
 void Window::hide() {
     if (m_visible) {
-        XUnmapWindow(m_app->getDisplay(), m_xwindow);
+        if (m_xwindow) {
+            XUnmapWindow(m_app->getDisplay(), m_xwindow);
+        }
         m_visible = false;
         setVisible(false);
     }
@@ -101,7 +224,9 @@ void Window::hide() {
 
 void Window::setTitle(const std::string& title) {
     m_title = title;
-    XStoreName(m_app->getDisplay(), m_xwindow, m_title.c_str());
+    if (m_xwindow) {
+        XStoreName(m_app->getDisplay(), m_xwindow, m_title.c_str());
+    }
 }
 
 void Window::setPosition(int x, int y) {
@@ -109,6 +234,7 @@ void Window::setPosition(int x, int y) {
     bounds.x = x;
     bounds.y = y;
     setBounds(bounds);
+    if (!m_xwindow) return;
     
     // Force X window position
     XMoveWindow(m_app->getDisplay(), m_xwindow, x, y);
@@ -124,87 +250,73 @@ void Window::setPosition(int x, int y) {
     }
 }
 
-bool Window::isDropdownWidget(Widget* widget) {
-    // Check if widget is a Dropdown (simple type check)
-    return dynamic_cast<class Dropdown*>(widget) != nullptr;
-}
-
-bool Window::isDropdownOpen(Widget* widget) {
-    auto dropdown = dynamic_cast<class Dropdown*>(widget);
-    return dropdown && dropdown->isOpen();
+void Window::setBackgroundPixmap(Pixmap pixmap) {
+    // Nothing to tile it with when headless
+    if (!m_xwindow) return;
+    m_backgroundPixmap = pixmap;
+    XSetWindowBackgroundPixmap(m_app->getDisplay(), m_xwindow, pixmap);
+    
+    // Repaint with the new background if we are already on screen
+    if (m_visible) {
+        XClearArea(m_app->getDisplay(), m_xwindow, 0, 0, 0, 0, True);
+    }
 }
 
 void Window::closeAllDropdowns() {
-    for (auto& child : getChildren()) {
-        auto dropdown = dynamic_cast<class Dropdown*>(child.get());
-        if (dropdown && dropdown->isOpen()) {
-            dropdown->setOpen(false);
-        }
-    }
+    dismissPopups();
 }
 
 bool Window::handleX11Event(const XEvent& xevent) {
-    // Check if this event belongs to our window
-    ::Window eventWindow = None;
-    
+    // Application routes by xany.window, so everything that gets here is ours
     switch (xevent.type) {
         case Expose:
-            eventWindow = xevent.xexpose.window;
-            break;
-        case ButtonPress:
-        case ButtonRelease:
-            eventWindow = xevent.xbutton.window;
-            break;
-        case MotionNotify:
-            eventWindow = xevent.xmotion.window;
-            break;
-        case KeyPress:
-            eventWindow = xevent.xkey.window;
-            break;
-        case ConfigureNotify:
-            eventWindow = xevent.xconfigure.window;
-            break;
-        default:
-            return false;
-    }
-    
-    if (eventWindow != m_xwindow) {
-        return false;
-    }
-    
-    // Handle the event
-    switch (xevent.type) {
-        case Expose:
-            if (xevent.xexpose.count == 0) { // Only redraw on last expose event
-                draw(m_xwindow, m_app->getDefaultGC());
-            }
+            // The application paints once the whole series is in
+            invalidate(Rect(xevent.xexpose.x, xevent.xexpose.y,
+                            xevent.xexpose.width, xevent.xexpose.height));
             break;
             
         case ButtonPress:
         case ButtonRelease: {
             Event guiEvent = convertX11Event(xevent);
             Widget* target = findWidgetAt(guiEvent.x, guiEvent.y);
-            if (target) {
-                guiEvent.target = target;
-                target->triggerEvent(guiEvent);
-            } else {
-                guiEvent.target = this;
-                triggerEvent(guiEvent);
-            }
+            dispatchEvent(target ? target : this, guiEvent);
             break;
         }
         
         case MotionNotify: {
-            Event guiEvent = convertX11Event(xevent);
-            guiEvent.type = HOVER;
+            // Only the latest position matters; skip motion queued right
+            // behind this one. Not past other events, or hover would get
+            // ahead of clicks and crossings. Nothing queues without a display.
+            XEvent latest = xevent;
+            Display* display = m_app->getDisplay();
+            while (m_xwindow && XEventsQueued(display, QueuedAlready)) {
+                XEvent next;
+                XPeekEvent(display, &next);
+                if (next.type != MotionNotify || next.xmotion.window != m_xwindow) break;
+                XNextEvent(display, &latest);
+            }
+            
+            Event guiEvent = convertX11Event(latest);
+            if (guiEvent.x == m_hoverX && guiEvent.y == m_hoverY) break;
+            m_hoverX = guiEvent.x;
+            m_hoverY = guiEvent.y;
+            
             Widget* target = findWidgetAt(guiEvent.x, guiEvent.y);
+            updateHover(target, guiEvent);
             if (target) {
-                guiEvent.target = target;
-                target->triggerEvent(guiEvent);
+                dispatchEvent(target, guiEvent);
             }
             break;
         }
         
+        case LeaveNotify: {
+            Event guiEvent = {};
+            guiEvent.x = m_hoverX = xevent.xcrossing.x;
+            guiEvent.y = m_hoverY = xevent.xcrossing.y;
+            updateHover(nullptr, guiEvent);
+            break;
+        }
+        
         case KeyPress: {
             Event guiEvent = convertX11Event(xevent);
             guiEvent.target = this;
@@ -217,6 +329,9 @@ bool Window::handleX11Event(const XEvent& xevent) {
             setBounds(Rect(xevent.xconfigure.x, xevent.xconfigure.y,
                           xevent.xconfigure.width, xevent.xconfigure.height));
             break;
+            
+        default:
+            return false;
     }
     
     return true;
@@ -255,15 +370,35 @@ Event Window::convertX11Event(const XEvent& xevent) {
     return event;
 }
 
-Widget* Window::findWidgetAt(int x, int y) {
-    // Search children in reverse order (top to bottom)
-    for (auto it = getChildren().rbegin(); it != getChildren().rend(); ++it) {
-        auto& child = *it;
-        if (child->isVisible() && child->getBounds().contains(x, y)) {
-            return child.get();
+void Window::updateHover(Widget* target, const Event& event) {
+    if (target == m_hoverWidget) return;
+    
+    Widget* previous = m_hoverWidget;
+    m_hoverWidget = target;
+    
+    if (previous) {
+        Event leave = event;
+        leave.type = LEAVE;
+        leave.target = previous;
+        previous->triggerEvent(leave);
+    }
+    
+    if (target) {
+        Event enter = event;
+        enter.type = ENTER;
+        enter.target = target;
+        target->triggerEvent(enter);
+    }
+}
+
+void Window::widgetRemoved(Widget* widget) {
+    // Forget the hovered widget if it is going away with `widget`
+    for (Widget* w = m_hoverWidget; w; w = w->getParent()) {
+        if (w == widget) {
+            m_hoverWidget = nullptr;
+            break;
         }
     }
-    return nullptr;
 }
 
 } // namespace InWM
\ No newline at end of file
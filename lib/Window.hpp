@@ -1,12 +1,14 @@
 #ifndef INWM_WINDOW_HPP
 #define INWM_WINDOW_HPP
 
+#include "DrawContext.hpp"
 #include "GUI.hpp"
+#include "WidgetArena.hpp"
 
 namespace InWM {
 
-// Forward declarations
-class Dropdown;
+class Raster;
+class RasterSurface;
 
 class Window : public Widget {
 public:
@@ -14,7 +16,7 @@ public:
     ~Window();
 
     // Widget interface
-    void draw(Drawable drawable, GC gc) override;
+    void draw(DrawContext& dc) override;
     void handleEvent(const Event& event) override;
     
     // Window specific methods
@@ -26,6 +28,29 @@ public:
     // Force window position
     void setPosition(int x, int y);
     
+    // Let the X server paint the background by tiling a pixmap, so exposures
+    // are filled without a round trip through draw()
+    void setBackgroundPixmap(Pixmap pixmap);
+    
+    // Collect dirty areas; paint() repaints them into the back-buffer and
+    // copies just those areas to the screen
+    using Widget::invalidate;
+    void invalidate(const Rect& rect) override;
+    void paint();
+    bool needsPaint() const;
+    
+    // Draw widgets into client memory and put just the damaged area on
+    // screen (through shared memory when the server allows it), instead of
+    // sending a drawing request per primitive. Not used while a background
+    // pixmap is set. Returns false if the display's pixel format is one the
+    // rasterizer can't write. Headless windows always render this way.
+    bool setRasterRendering(bool enabled);
+    bool isRasterRendering() const { return m_raster != nullptr; }
+    
+    // The pixels as of the last paint(), or nullptr if not rendering to a
+    // raster (or never painted)
+    const Raster* getRaster() const;
+    
     // X11 event handling
     bool handleX11Event(const XEvent& xevent);
     
@@ -34,16 +59,44 @@ public:
     // Dropdown management
     void closeAllDropdowns();
     
+    // Construct a widget in this window's arena: `create<Button>("OK")`
+    // passes the application first, like the constructors expect. It lives
+    // until the window is destroyed; add it with addChild(widget).
+    template<typename T, typename... Args>
+    T* create(Args&&... args) {
+        return m_arena.create<T>(m_app, std::forward<Args>(args)...);
+    }
+    WidgetArena& getArena() { return m_arena; }
+    
+protected:
+    void widgetRemoved(Widget* widget) override;
+    
 private:
     void createXWindow();
+    void drawArea(DrawContext& dc, const Rect& area);
+    void paintRaster(const Rect& area);
     Event convertX11Event(const XEvent& xevent);
-    Widget* findWidgetAt(int x, int y);
-    bool isDropdownWidget(Widget* widget);
-    bool isDropdownOpen(Widget* widget);
+    void updateHover(Widget* target, const Event& event);
     
     std::string m_title;
-    ::Window m_xwindow;
+    ::Window m_xwindow = None;   // None when headless
+    Pixmap m_backgroundPixmap = None;
     bool m_visible = false;
+    
+    // Child under the pointer, for ENTER/LEAVE
+    Widget* m_hoverWidget = nullptr;
+    int m_hoverX = -1, m_hoverY = -1;
+    
+    // Painting
+    GC m_gc = nullptr;
+    Pixmap m_backBuffer = None;
+    int m_bufferWidth = 0, m_bufferHeight = 0;
+    Region m_dirtyRegion;
+    XDrawContext m_drawContext;
+    std::unique_ptr<RasterSurface> m_raster;
+    
+    // Declared last so arena widgets go before everything else
+    WidgetArena m_arena;
 };
 
 } // namespace InWM
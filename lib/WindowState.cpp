@@ -0,0 +1,235 @@
+#include "WindowState.hpp"
+#include "WorkerPool.hpp"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace InWM {
+
+namespace {
+
+const uint32_t STATE_MAGIC = 0x53574e49;  // "INWS"
+const uint32_t STATE_VERSION = 1;
+const uint32_t STATE_CAPACITY = 1024;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "the seqlock lives in memory shared between processes");
+
+long futex(const std::atomic<uint32_t>* word, int op, uint32_t value, const timespec* timeout) {
+  // Not FUTEX_PRIVATE_FLAG, the waiters are in other processes
+  return syscall(SYS_futex, reinterpret_cast<const uint32_t*>(word), op, value, timeout,
+                 nullptr, 0);
+}
+
+}
+
+struct WindowStateSegment {
+  uint32_t m_magic;
+  uint32_t m_version;
+  uint32_t m_capacity;
+  int32_t m_writerPid;
+  std::atomic<uint32_t> m_sequence;  // Odd while the writer is in the middle of an update
+  uint32_t m_count;
+  WindowStateEntry m_entries[STATE_CAPACITY];
+};
+
+std::string windowStateName(Display* dpy) {
+  std::string name = "/inwm-" + std::to_string(getuid()) + "-";
+  for (const char* c = DisplayString(dpy); *c; ++c) {
+    name += isalnum((unsigned char)*c) ? *c : '_';
+  }
+  return name;
+}
+
+WindowStateWriter::WindowStateWriter() : m_segment(nullptr) {}
+
+WindowStateWriter::~WindowStateWriter() {
+  if (m_segment) {
+    munmap(m_segment, sizeof(WindowStateSegment));
+  }
+}
+
+bool WindowStateWriter::open(Display* dpy) {
+  // Titles are nobody else's business, and readers only ever map it
+  // read-only anyway
+  int fd = shm_open(windowStateName(dpy).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    perror("shm_open");
+    return false;
+  }
+
+  // Someone else may have created it first to feed panels their own list.
+  // An old segment of ours may still be readable by others; fix that.
+  struct stat info;
+  if (fstat(fd, &info) < 0 || info.st_uid != getuid()) {
+    fprintf(stderr, "%s is not ours, not publishing window state\n",
+            windowStateName(dpy).c_str());
+    close(fd);
+    return false;
+  }
+  if ((info.st_mode & 0777) != 0600 && fchmod(fd, 0600) < 0) {
+    perror("fchmod");
+    close(fd);
+    return false;
+  }
+
+  if (ftruncate(fd, sizeof(WindowStateSegment)) < 0) {
+    perror("ftruncate");
+    close(fd);
+    return false;
+  }
+
+  void* map = mmap(nullptr, sizeof(WindowStateSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror("mmap");
+    return false;
+  }
+
+  // After a restart the segment is still there; keep the sequence counting
+  // up so readers notice the new snapshot
+  m_segment = static_cast<WindowStateSegment*>(map);
+  m_segment->m_magic = STATE_MAGIC;
+  m_segment->m_version = STATE_VERSION;
+  m_segment->m_capacity = STATE_CAPACITY;
+  m_segment->m_writerPid = getpid();
+  if (m_segment->m_sequence.load() & 1) {
+    m_segment->m_sequence++;
+  }
+  return true;
+}
+
+void WindowStateWriter::publish(const std::vector<WindowStateEntry>& entries) {
+  if (!m_segment) return;
+
+  uint32_t sequence = m_segment->m_sequence.load(std::memory_order_relaxed);
+  m_segment->m_sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  uint32_t count = std::min<size_t>(entries.size(), STATE_CAPACITY);
+  memcpy(m_segment->m_entries, entries.data(), count * sizeof(WindowStateEntry));
+  m_segment->m_count = count;
+
+  m_segment->m_sequence.store(sequence + 2, std::memory_order_release);
+
+  // Readers map the segment read-only and cannot register themselves, so
+  // always wake; publishing only happens on actual window changes
+  futex(&m_segment->m_sequence, FUTEX_WAKE, INT_MAX, nullptr);
+}
+
+WindowStateReader::WindowStateReader()
+: m_segment(nullptr), m_watching(false) {}
+
+WindowStateReader::~WindowStateReader() {
+  if (m_watcher.joinable()) {
+    m_watching = false;
+    m_watcher.join();
+  }
+
+  // A call may still be queued; it keeps the state alive but must not call
+  // back into whoever owned us
+  if (m_watchState) {
+    m_watchState->m_active = false;
+  }
+
+  if (m_segment) {
+    munmap(const_cast<WindowStateSegment*>(m_segment), sizeof(WindowStateSegment));
+  }
+}
+
+bool WindowStateReader::open(Display* dpy) {
+  int fd = shm_open(windowStateName(dpy).c_str(), O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0) return false;
+
+  // Only trust a segment our own user's window manager wrote, and one big
+  // enough that reading it cannot fault
+  struct stat info;
+  if (fstat(fd, &info) < 0 || info.st_uid != getuid() ||
+      info.st_size < (off_t)sizeof(WindowStateSegment)) {
+    close(fd);
+    return false;
+  }
+
+  void* map = mmap(nullptr, sizeof(WindowStateSegment), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return false;
+
+  // Left behind by a window manager that is no longer running
+  const WindowStateSegment* segment = static_cast<const WindowStateSegment*>(map);
+  if (segment->m_magic != STATE_MAGIC || segment->m_version != STATE_VERSION ||
+      kill(segment->m_writerPid, 0) != 0) {
+    munmap(map, sizeof(WindowStateSegment));
+    return false;
+  }
+
+  m_segment = segment;
+  return true;
+}
+
+bool WindowStateReader::read(std::vector<WindowStateEntry>& entries) const {
+  if (!m_segment) return false;
+
+  while (true) {
+    uint32_t before = m_segment->m_sequence.load(std::memory_order_acquire);
+    if (before & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    uint32_t count = std::min(m_segment->m_count, STATE_CAPACITY);
+    entries.resize(count);
+    memcpy(entries.data(), m_segment->m_entries, count * sizeof(WindowStateEntry));
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_segment->m_sequence.load(std::memory_order_relaxed) == before) {
+      return true;
+    }
+  }
+}
+
+void WindowStateReader::watch(std::function<void()> onChange) {
+  if (!m_segment || m_watcher.joinable()) return;
+
+  m_watching = true;
+  m_watchState = std::make_shared<WatchState>();
+  m_watchState->m_onChange = std::move(onChange);
+  m_watcher = std::thread(&WindowStateReader::watchLoop, m_segment, &m_watching, m_watchState);
+}
+
+void WindowStateReader::watchLoop(const WindowStateSegment* segment,
+                                  const std::atomic<bool>* watching,
+                                  std::shared_ptr<WatchState> state) {
+  // Wake up now and then to notice that we are being destroyed
+  const timespec timeout = { 0, 500 * 1000 * 1000 };
+  const std::atomic<uint32_t>& sequence = segment->m_sequence;
+  uint32_t seen = sequence.load();
+
+  while (*watching) {
+    // Returns at once if the sequence already moved past `seen`
+    futex(&sequence, FUTEX_WAIT, seen, &timeout);
+
+    uint32_t current = sequence.load();
+    if (current == seen || (current & 1)) continue;
+    seen = current;
+
+    if (!state->m_notifyQueued.exchange(true)) {
+      WorkerPool::shared().post([state]() {
+        state->m_notifyQueued = false;
+        if (state->m_active) {
+          state->m_onChange();
+        }
+      });
+    }
+  }
+}
+
+} // namespace InWM
@@ -0,0 +1,111 @@
+#ifndef INWM_WINDOWSTATE_HPP
+#define INWM_WINDOWSTATE_HPP
+
+extern "C" {
+#include <X11/Xlib.h>
+}
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace InWM {
+
+// Window list published by inwm in shared memory, so panels can read it
+// without X round trips or racing property updates.
+//
+// The window manager owns a single writer; any number of processes map it
+// read-only. A seqlock keeps readers from seeing a half-written snapshot and
+// the sequence word doubles as a futex for change notification. The segment
+// is private to the user running inwm (mode 0600), and both sides refuse one
+// owned by anybody else.
+
+struct WindowStateSegment;
+
+// One managed window
+struct WindowStateEntry {
+  uint64_t m_id;          // Client window XID
+  int32_t m_x;            // Frame geometry
+  int32_t m_y;
+  int32_t m_width;
+  int32_t m_height;
+  uint32_t m_workspace;   // Always 0 until inwm has workspaces
+  uint8_t m_focused;
+  uint8_t m_snapState;    // SnapState in WindowManager.hpp
+  uint16_t m_titleLength;
+  char m_title[128];      // UTF-8, truncated, not terminated
+
+  // The length comes from another process; never read past the entry
+  std::string title() const {
+    return std::string(m_title, m_titleLength < sizeof(m_title) ? m_titleLength : sizeof(m_title));
+  }
+};
+
+// Writer side, used by the window manager
+class WindowStateWriter {
+  public:
+    WindowStateWriter();
+    ~WindowStateWriter();
+
+    WindowStateWriter(const WindowStateWriter&) = delete;
+    WindowStateWriter& operator=(const WindowStateWriter&) = delete;
+
+    // Create (or take over) the segment for this display
+    bool open(Display* dpy);
+
+    // Replace the snapshot and wake anyone waiting for a change
+    void publish(const std::vector<WindowStateEntry>& entries);
+
+  private:
+    WindowStateSegment* m_segment;
+};
+
+// Reader side, for the bar and libinwm applications
+class WindowStateReader {
+  public:
+    WindowStateReader();
+    ~WindowStateReader();
+
+    WindowStateReader(const WindowStateReader&) = delete;
+    WindowStateReader& operator=(const WindowStateReader&) = delete;
+
+    // Map the segment published by a running inwm. Fails if there is none,
+    // in which case callers fall back to X properties.
+    bool open(Display* dpy);
+    bool isOpen() const { return m_segment != nullptr; }
+
+    // Consistent copy of the current window list, in mapping order
+    bool read(std::vector<WindowStateEntry>& entries) const;
+
+    // Call `onChange` on the event loop (through WorkerPool::post) whenever
+    // a new snapshot is published. Changes that arrive while a call is still
+    // queued are folded into it. A call still queued when the reader is
+    // destroyed does nothing.
+    void watch(std::function<void()> onChange);
+
+  private:
+    // Shared with queued calls, which may outlive the reader
+    struct WatchState {
+      std::function<void()> m_onChange;
+      std::atomic<bool> m_notifyQueued{false};
+      bool m_active = true;   // Only touched on the event loop
+    };
+
+    static void watchLoop(const WindowStateSegment* segment, const std::atomic<bool>* watching,
+                          std::shared_ptr<WatchState> state);
+
+    const WindowStateSegment* m_segment;
+    std::thread m_watcher;
+    std::atomic<bool> m_watching;
+    std::shared_ptr<WatchState> m_watchState;
+};
+
+// Shared memory object name for a display, e.g. "/inwm-1000-_0"
+std::string windowStateName(Display* dpy);
+
+} // namespace InWM
+
+#endif
@@ -0,0 +1,183 @@
+#include "WorkerPool.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace InWM {
+
+namespace {
+
+// Pool and worker index running on this thread, if any
+thread_local const WorkerPool* t_pool = nullptr;
+thread_local size_t t_workerIndex = 0;
+
+}
+
+WorkerPool& WorkerPool::shared() {
+  static WorkerPool pool;
+  return pool;
+}
+
+WorkerPool::WorkerPool(unsigned threads) : m_threadCount(threads) {
+  if (m_threadCount == 0) {
+    unsigned cores = std::thread::hardware_concurrency();
+    m_threadCount = std::max(1u, std::min(8u, cores > 1 ? cores - 1 : 1));
+  }
+
+  m_eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_eventFd < 0) {
+    perror("eventfd");
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+
+  for (auto& worker : m_workers) {
+    if (worker->m_thread.joinable()) {
+      worker->m_thread.join();
+    }
+  }
+
+  // Drop whatever the event loop never picked up
+  CompletionNode* node = m_completions.exchange(nullptr);
+  while (node) {
+    CompletionNode* next = node->m_next;
+    delete node;
+    node = next;
+  }
+
+  if (m_eventFd >= 0) {
+    close(m_eventFd);
+  }
+}
+
+void WorkerPool::start() {
+  for (unsigned i = 0; i < m_threadCount; ++i) {
+    m_workers.emplace_back(new Worker());
+  }
+  for (unsigned i = 0; i < m_threadCount; ++i) {
+    m_workers[i]->m_thread = std::thread(&WorkerPool::workerLoop, this, i);
+  }
+}
+
+void WorkerPool::submit(Task task) {
+  std::call_once(m_started, &WorkerPool::start, this);
+
+  // Work spawned by a worker stays local, the rest is spread round-robin
+  size_t index = t_pool == this ? t_workerIndex : m_nextWorker++ % m_workers.size();
+  {
+    std::lock_guard<std::mutex> lock(m_workers[index]->m_mutex);
+    m_workers[index]->m_tasks.push_back(std::move(task));
+  }
+
+  m_queued++;
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+  }
+  m_wake.notify_one();
+}
+
+void WorkerPool::post(Completion completion) {
+  CompletionNode* node = new CompletionNode{ std::move(completion), nullptr };
+
+  // The node belongs to the consumer as soon as it is published, so keep
+  // the previous head in a local
+  CompletionNode* head = m_completions.load(std::memory_order_relaxed);
+  do {
+    node->m_next = head;
+  } while (!m_completions.compare_exchange_weak(head, node,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed));
+
+  // Only the first completion of a batch needs to wake the loop
+  if (head == nullptr) {
+    uint64_t one = 1;
+    if (write(m_eventFd, &one, sizeof(one)) < 0) {
+      perror("eventfd write");
+    }
+  }
+}
+
+size_t WorkerPool::runCompletions() {
+  // Reset the eventfd before taking the list, so a post that races with us
+  // leaves it readable for the next poll
+  uint64_t count;
+  while (read(m_eventFd, &count, sizeof(count)) > 0) {}
+
+  CompletionNode* node = m_completions.exchange(nullptr, std::memory_order_acquire);
+
+  // The stack is newest first, run them in the order they were posted
+  CompletionNode* ordered = nullptr;
+  while (node) {
+    CompletionNode* next = node->m_next;
+    node->m_next = ordered;
+    ordered = node;
+    node = next;
+  }
+
+  size_t ran = 0;
+  while (ordered) {
+    CompletionNode* next = ordered->m_next;
+    ordered->m_completion();
+    delete ordered;
+    ordered = next;
+    ran++;
+  }
+  return ran;
+}
+
+bool WorkerPool::popTask(size_t index, Task& task) {
+  // Newest from our own deque first, it is most likely still in cache
+  {
+    Worker& own = *m_workers[index];
+    std::lock_guard<std::mutex> lock(own.m_mutex);
+    if (!own.m_tasks.empty()) {
+      task = std::move(own.m_tasks.back());
+      own.m_tasks.pop_back();
+      return true;
+    }
+  }
+
+  // Otherwise steal the oldest task from someone else
+  for (size_t i = 1; i < m_workers.size(); ++i) {
+    Worker& victim = *m_workers[(index + i) % m_workers.size()];
+    std::lock_guard<std::mutex> lock(victim.m_mutex);
+    if (!victim.m_tasks.empty()) {
+      task = std::move(victim.m_tasks.front());
+      victim.m_tasks.pop_front();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void WorkerPool::workerLoop(size_t index) {
+  t_pool = this;
+  t_workerIndex = index;
+
+  while (true) {
+    Task task;
+    if (popTask(index, task)) {
+      m_queued--;
+      Completion completion = task();
+      if (completion) {
+        post(std::move(completion));
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_wake.wait(lock, [this] { return m_stopping || m_queued > 0; });
+    if (m_stopping) return;
+  }
+}
+
+} // namespace InWM
@@ -0,0 +1,83 @@
+#ifndef INWM_WORKERPOOL_HPP
+#define INWM_WORKERPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace InWM {
+
+// Worker threads for anything too slow for the X event thread: image
+// decoding, icon conversion, /proc sampling and so on.
+//
+// A task runs on a worker and returns a completion (or nullptr). Completions
+// go onto a lock-free queue and wake the event loop through an eventfd; the
+// loop then applies them on the X thread in one batch with runCompletions().
+//
+// Each worker has its own deque; idle workers steal from the others.
+class WorkerPool {
+  public:
+    using Completion = std::function<void()>;
+    using Task = std::function<Completion()>;
+
+    // Pool shared by everything in the process
+    static WorkerPool& shared();
+
+    // 0 threads means one less than the number of cores (at least one)
+    explicit WorkerPool(unsigned threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Run `task` on a worker. Threads are started on first use.
+    void submit(Task task);
+
+    // Queue `completion` for the event loop. Safe from any thread.
+    void post(Completion completion);
+
+    // Readable when completions are waiting; poll() it next to the X fd
+    int completionFd() const { return m_eventFd; }
+
+    // Run every queued completion in order. Call from the X thread.
+    size_t runCompletions();
+
+  private:
+    struct Worker {
+      std::mutex m_mutex;
+      std::deque<Task> m_tasks;
+      std::thread m_thread;
+    };
+
+    struct CompletionNode {
+      Completion m_completion;
+      CompletionNode* m_next;
+    };
+
+    void start();
+    void workerLoop(size_t index);
+    bool popTask(size_t index, Task& task);
+
+    unsigned m_threadCount;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::once_flag m_started;
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::atomic<size_t> m_queued{0};
+    std::atomic<size_t> m_nextWorker{0};
+    std::atomic<bool> m_stopping{false};
+
+    // Intrusive MPSC stack, newest first; the consumer takes it all at once
+    std::atomic<CompletionNode*> m_completions{nullptr};
+    int m_eventFd;
+};
+
+} // namespace InWM
+
+#endif
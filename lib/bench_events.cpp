@@ -0,0 +1,107 @@
+#include "Widgets.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <utility>
+#include <vector>
+
+using namespace InWM;
+
+// Times Widget::triggerEvent against the listener storage it replaced: one
+// vector of (type, std::function) pairs scanned on every event.
+//
+//   bench_events [--iterations N]
+//
+// Build it optimized, e.g. `make CXXFLAGS="-O2 -std=c++17" bench`; the
+// default flags have no optimization.
+
+namespace {
+
+// Listeners bump this so the calls can't be optimized out
+volatile unsigned long s_calls = 0;
+
+struct Plain : Widget {
+    Plain() : Widget(nullptr) {}
+    void draw(DrawContext&) override {}
+};
+
+// The pre-slot dispatch, kept here only to compare against
+struct Previous {
+    virtual ~Previous() = default;
+    virtual void handleEvent(const Event&) {}
+
+    void setEventCallback(EventType type, std::function<void(const Event&)> callback) {
+        m_callbacks.emplace_back(type, std::move(callback));
+    }
+
+    void triggerEvent(const Event& event) {
+        handleEvent(event);
+        for (const auto& [eventType, callback] : m_callbacks) {
+            if (eventType == event.type) {
+                callback(event);
+            }
+        }
+    }
+
+    std::vector<std::pair<EventType, std::function<void(const Event&)>>> m_callbacks;
+};
+
+struct Case {
+    const char* name;
+    int clickListeners;     // Registered for CLICK
+    int otherListeners;     // Registered for HOVER, ENTER and LEAVE in turn
+    EventType triggered;
+};
+
+const Case CASES[] = {
+    { "no listener for the type", 3, 3, KEY_PRESS },
+    { "1 matching listener", 1, 3, CLICK },
+    { "3 matching listeners", 3, 3, CLICK },
+};
+
+template<typename Target>
+double nsPerEvent(Target& target, const Event& event, long iterations) {
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        target.triggerEvent(event);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    long iterations = 20 * 1000 * 1000;
+    if (argc == 3 && strcmp(argv[1], "--iterations") == 0) {
+        iterations = std::max(1L, atol(argv[2]));
+    } else if (argc != 1) {
+        fprintf(stderr, "Usage: %s [--iterations N]\n", argv[0]);
+        return 2;
+    }
+
+    const EventType others[] = { HOVER, ENTER, LEAVE };
+    auto listener = [](const Event&) { s_calls = s_calls + 1; };
+
+    printf("%-26s %10s %10s\n", "triggerEvent", "previous", "now");
+    for (const Case& c : CASES) {
+        Previous previous;
+        Plain widget;
+        for (int i = 0; i < c.clickListeners + c.otherListeners; ++i) {
+            EventType type = i < c.clickListeners ? CLICK : others[i % 3];
+            previous.setEventCallback(type, listener);
+            widget.addEventCallback(type, listener);
+        }
+
+        Event event = {};
+        event.type = c.triggered;
+        event.target = &widget;
+        double before = nsPerEvent(previous, event, iterations);
+        double now = nsPerEvent(widget, event, iterations);
+        printf("%-26s %7.2f ns %7.2f ns\n", c.name, before, now);
+    }
+    return 0;
+}
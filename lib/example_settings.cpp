@@ -34,7 +34,7 @@ private:
         // (In a real implementation, you'd add a Label widget for text)
         
         // Display section
-        auto displayDropdown = std::make_shared<Dropdown>(m_app.get(), "Display Resolution");
+        auto displayDropdown = m_window->create<Dropdown>("Display Resolution");
         displayDropdown->setBounds(Rect(20, 30, 150, 25));
         displayDropdown->addItem("1024x768", [](const Event& e) { 
             printf("Resolution: 1024x768 selected\n"); 
@@ -48,7 +48,7 @@ private:
         m_window->addChild(displayDropdown);
         
         // Sound section
-        auto soundDropdown = std::make_shared<Dropdown>(m_app.get(), "Sound Output");
+        auto soundDropdown = m_window->create<Dropdown>("Sound Output");
         soundDropdown->setBounds(Rect(20, 70, 150, 25));
         soundDropdown->addItem("Speakers", [](const Event& e) { 
             printf("Sound: Speakers selected\n"); 
@@ -62,7 +62,7 @@ private:
         m_window->addChild(soundDropdown);
         
         // Network section
-        auto networkDropdown = std::make_shared<Dropdown>(m_app.get(), "Network");
+        auto networkDropdown = m_window->create<Dropdown>("Network");
         networkDropdown->setBounds(Rect(20, 110, 150, 25));
         networkDropdown->addItem("Ethernet", [](const Event& e) { 
             printf("Network: Ethernet selected\n"); 
@@ -76,21 +76,21 @@ private:
         m_window->addChild(networkDropdown);
         
         // Control buttons
-        auto applyButton = std::make_shared<Button>(m_app.get(), "Apply Settings");
+        auto applyButton = m_window->create<Button>("Apply Settings");
         applyButton->setBounds(Rect(250, 300, 120, 30));
         applyButton->setEventCallback(CLICK, [](const Event& e) {
             printf("Settings applied successfully!\n");
         });
         m_window->addChild(applyButton);
         
-        auto resetButton = std::make_shared<Button>(m_app.get(), "Reset to Defaults");
+        auto resetButton = m_window->create<Button>("Reset to Defaults");
         resetButton->setBounds(Rect(250, 340, 120, 30));
         resetButton->setEventCallback(CLICK, [](const Event& e) {
             printf("Settings reset to defaults\n");
         });
         m_window->addChild(resetButton);
         
-        auto closeButton = std::make_shared<Button>(m_app.get(), "Close");
+        auto closeButton = m_window->create<Button>("Close");
         closeButton->setBounds(Rect(380, 340, 80, 30));
         closeButton->setEventCallback(CLICK, [this](const Event& e) {
             printf("Closing settings application\n");
@@ -99,7 +99,7 @@ private:
         m_window->addChild(closeButton);
         
         // Advanced settings dropdown (demonstrates System 8 style menu)
-        auto advancedMenu = std::make_shared<Dropdown>(m_app.get(), "Advanced");
+        auto advancedMenu = m_window->create<Dropdown>("Advanced");
         advancedMenu->setBounds(Rect(20, 300, 100, 25));
         advancedMenu->addItem("System Info", [](const Event& e) { 
             printf("System Info requested\n"); 
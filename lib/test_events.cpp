@@ -0,0 +1,135 @@
+#include "Widgets.hpp"
+#include <cstdio>
+
+using namespace InWM;
+
+// Event dispatch cases that are easy to get wrong: listeners that change
+// the listeners of the widget they run on, and events dispatched from
+// inside a listener. Run under ASan to catch a listener being moved or
+// destroyed while it runs.
+
+namespace {
+
+int s_failures = 0;
+
+void expect(bool condition, const char* what) {
+    printf("%-60s %s\n", what, condition ? "ok" : "FAIL");
+    if (!condition) ++s_failures;
+}
+
+struct Plain : Widget {
+    Plain() : Widget(nullptr) {}
+    void draw(DrawContext&) override {}
+};
+
+Event eventOf(EventType type, Widget* target) {
+    Event event = {};
+    event.type = type;
+    event.target = target;
+    return event;
+}
+
+void addToLowerSlot() {
+    // CLICK comes before HOVER, so adding one shifts the HOVER slot
+    Plain widget;
+    int hovers = 0, clicks = 0;
+    widget.addEventCallback(HOVER, [&](const Event&) {
+        ++hovers;
+        widget.addEventCallback(CLICK, [&](const Event&) { ++clicks; });
+    });
+    widget.triggerEvent(eventOf(HOVER, &widget));
+    expect(hovers == 1, "listener adding to a lower slot runs once");
+
+    widget.triggerEvent(eventOf(CLICK, &widget));
+    expect(clicks == 1, "the added listener runs for the next event");
+}
+
+void addToOwnSlot() {
+    Plain widget;
+    int first = 0, added = 0;
+    widget.addEventCallback(CLICK, [&](const Event&) {
+        ++first;
+        widget.addEventCallback(CLICK, [&](const Event&) { ++added; });
+    });
+    widget.triggerEvent(eventOf(CLICK, &widget));
+    expect(first == 1 && added == 0, "listener added to the running slot waits");
+
+    widget.triggerEvent(eventOf(CLICK, &widget));
+    expect(first == 2 && added == 1, "and runs from the next event on");
+}
+
+void replaceWhileRunning() {
+    // The old listener is still running when set* asks to destroy it
+    Plain widget;
+    int old = 0, replacement = 0;
+    widget.setEventCallback(CLICK, [&](const Event&) {
+        ++old;
+        widget.setEventCallback(CLICK, [&](const Event&) { ++replacement; });
+    });
+    widget.triggerEvent(eventOf(CLICK, &widget));
+    widget.triggerEvent(eventOf(CLICK, &widget));
+    expect(old == 1 && replacement == 1, "listener replacing itself");
+}
+
+void nestedDispatch() {
+    // The inner dispatch finishes first; changes wait for the outer one
+    Plain widget;
+    int clicks = 0, hovers = 0, added = 0;
+    widget.addEventCallback(CLICK, [&](const Event&) {
+        ++clicks;
+        widget.triggerEvent(eventOf(HOVER, &widget));
+    });
+    widget.addEventCallback(HOVER, [&](const Event&) {
+        ++hovers;
+        widget.addEventCallback(HOVER, [&](const Event&) { ++added; });
+    });
+    widget.triggerEvent(eventOf(CLICK, &widget));
+    expect(clicks == 1 && hovers == 1 && added == 0, "nested dispatch");
+
+    widget.triggerEvent(eventOf(HOVER, &widget));
+    expect(hovers == 2 && added == 1, "changes from a nested dispatch apply");
+}
+
+void captureThroughParent() {
+    // Capture listeners run on the ancestor, which adds to its own slots
+    Plain parent, child;
+    parent.addChild(&child);
+    int captured = 0, bubbled = 0;
+    parent.addCaptureCallback(CLICK, [&](const Event&) {
+        ++captured;
+        parent.addEventCallback(CLICK, [&](const Event&) { ++bubbled; });
+    });
+    parent.dispatchEvent(&child, eventOf(CLICK, &child));
+    expect(captured == 1 && bubbled == 1, "bubble listener added while capturing runs");
+    parent.removeChild(&child);
+}
+
+void manyListeners() {
+    // More than a 16-bit slot offset can hold
+    Plain widget;
+    int clicks = 0, hovers = 0;
+    for (int i = 0; i < 70000; ++i) {
+        widget.addEventCallback(CLICK, [&](const Event&) { ++clicks; });
+    }
+    widget.addEventCallback(HOVER, [&](const Event&) { ++hovers; });
+    widget.triggerEvent(eventOf(HOVER, &widget));
+    widget.triggerEvent(eventOf(CLICK, &widget));
+    expect(clicks == 70000 && hovers == 1, "70,000 listeners on one widget");
+}
+
+} // namespace
+
+int main() {
+    addToLowerSlot();
+    addToOwnSlot();
+    replaceWhileRunning();
+    nestedDispatch();
+    captureThroughParent();
+    manyListeners();
+
+    if (s_failures) {
+        printf("%d checks failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
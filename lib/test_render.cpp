@@ -0,0 +1,324 @@
+#include "Widgets.hpp"
+#include "Raster.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace InWM;
+
+// Renders fixed widget scenes headless (no X server needed), compares each
+// frame to a golden image and reports how long painting took.
+//
+//   test_render [--update] [--golden DIR] [--repeat N]
+//
+// --update rewrites the golden images instead of comparing. On a mismatch
+// the frame is written to test_render_<scene>.ppm for a look.
+
+namespace {
+
+struct Image {
+    int width = 0, height = 0;
+    std::vector<uint32_t> pixels;   // 0xRRGGBB
+};
+
+struct Scene {
+    const char* name;
+    int width, height;
+    // Adds the widgets; events may be fed in after the first paint
+    void (*build)(InWM::Window* window);
+    void (*interact)(InWM::Window* window);
+};
+
+// Input goes through the same path as events from the server. Buttons are
+// only pressed, so they are drawn held down.
+void press(InWM::Window* window, int x, int y, int button = Button1) {
+    XEvent event = {};
+    event.type = ButtonPress;
+    event.xbutton.x = x;
+    event.xbutton.y = y;
+    event.xbutton.button = button;
+    window->handleX11Event(event);
+}
+
+void move(InWM::Window* window, int x, int y) {
+    XEvent event = {};
+    event.type = MotionNotify;
+    event.xmotion.x = x;
+    event.xmotion.y = y;
+    window->handleX11Event(event);
+}
+
+void buildButtons(InWM::Window* window) {
+    const char* labels[] = { "OK", "Cancel", "Apply" };
+    for (int i = 0; i < 3; ++i) {
+        Button* button = window->create<Button>(labels[i]);
+        button->setBounds(Rect(10 + i * 75, 20, 70, 30));
+        window->addChild(button);
+    }
+    Button* pressed = window->create<Button>("Pressed");
+    pressed->setBounds(Rect(10, 60, 100, 30));
+    pressed->setPressed(true);
+    window->addChild(pressed);
+}
+
+void buildMenus(InWM::Window* window) {
+    Dropdown* file = window->create<Dropdown>("File");
+    file->setBounds(Rect(10, 10, 80, 25));
+    file->addItem("New");
+    file->addItem("Open");
+    file->addSeparator();
+    file->addItem("Save");
+    file->addItem(MenuItem("Save As...", nullptr, false));
+    file->addSeparator();
+    file->addItem("Exit");
+    window->addChild(file);
+
+    Dropdown* edit = window->create<Dropdown>("Edit");
+    edit->setBounds(Rect(100, 10, 80, 25));
+    edit->addItem("Cut");
+    edit->addItem("Copy");
+    window->addChild(edit);
+}
+
+void openFileMenu(InWM::Window* window) {
+    press(window, 20, 20);
+    move(window, 30, 65);   // Over "Open"
+}
+
+void buildLongMenu(InWM::Window* window) {
+    Dropdown* dropdown = window->create<Dropdown>("Fonts");
+    dropdown->setBounds(Rect(10, 10, 120, 25));
+    for (int i = 0; i < 500; ++i) {
+        dropdown->addItem("Item " + std::to_string(i));
+    }
+    window->addChild(dropdown);
+}
+
+void scrollLongMenu(InWM::Window* window) {
+    press(window, 20, 20);
+    for (int i = 0; i < 3; ++i) {
+        press(window, 40, 100, Button5);
+    }
+    move(window, 40, 100);
+}
+
+void buildShortMenu(InWM::Window* window) {
+    Dropdown* dropdown = window->create<Dropdown>("Items");
+    dropdown->setBounds(Rect(10, 10, 120, 25));
+    for (int i = 0; i < 100; ++i) {
+        dropdown->addItem("Item " + std::to_string(i));
+    }
+    window->addChild(dropdown);
+}
+
+void scrollToMenuEnd(InWM::Window* window) {
+    // Far past the end; the last rows have to come into view
+    press(window, 20, 20);
+    for (int i = 0; i < 50; ++i) {
+        press(window, 40, 100, Button5);
+    }
+    move(window, 40, 285);
+}
+
+void buildToolbar(InWM::Window* window) {
+    for (int i = 0; i < 100; ++i) {
+        Button* button = window->create<Button>(std::to_string(i));
+        button->setBounds(Rect(4 + (i % 20) * 24, 4 + (i / 20) * 24, 22, 22));
+        window->addChild(button);
+    }
+}
+
+void pressToolbarButton(InWM::Window* window) {
+    press(window, 4 + 7 * 24 + 5, 4 + 2 * 24 + 5);
+}
+
+const Scene SCENES[] = {
+    { "buttons", 240, 100, buildButtons, nullptr },
+    { "menus", 200, 200, buildMenus, openFileMenu },
+    { "long_menu", 160, 240, buildLongMenu, scrollLongMenu },
+    { "menu_end", 160, 300, buildShortMenu, scrollToMenuEnd },
+    { "toolbar", 488, 128, buildToolbar, pressToolbarButton },
+};
+
+Image capture(const Raster& raster) {
+    Image image;
+    image.width = raster.getWidth();
+    image.height = raster.getHeight();
+    image.pixels.resize((size_t)image.width * image.height);
+    for (int y = 0; y < image.height; ++y) {
+        memcpy(&image.pixels[(size_t)y * image.width], raster.getPixels() + y * raster.getStride(),
+               image.width * sizeof(uint32_t));
+    }
+    return image;
+}
+
+// Binary PPM (P6), the format Wallpaper reads too
+bool writePPM(const std::string& path, const Image& image) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+    std::vector<unsigned char> row(image.width * 3);
+    for (int y = 0; y < image.height; ++y) {
+        for (int x = 0; x < image.width; ++x) {
+            uint32_t pixel = image.pixels[(size_t)y * image.width + x];
+            row[x * 3] = pixel >> 16;
+            row[x * 3 + 1] = pixel >> 8;
+            row[x * 3 + 2] = pixel;
+        }
+        fwrite(row.data(), 1, row.size(), file);
+    }
+    return fclose(file) == 0;
+}
+
+bool readPPM(const std::string& path, Image& image) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    int maxValue = 0;
+    bool ok = fscanf(file, "P6 %d %d %d", &image.width, &image.height, &maxValue) == 3 &&
+              maxValue == 255 && fgetc(file) != EOF && image.width > 0 && image.height > 0;
+    if (ok) {
+        std::vector<unsigned char> data((size_t)image.width * image.height * 3);
+        ok = fread(data.data(), 1, data.size(), file) == data.size();
+        image.pixels.resize((size_t)image.width * image.height);
+        for (size_t i = 0; ok && i < image.pixels.size(); ++i) {
+            image.pixels[i] = data[i * 3] << 16 | data[i * 3 + 1] << 8 | data[i * 3 + 2];
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+// Number of differing pixels and the box around them
+int compare(const Image& actual, const Image& expected, Rect& box) {
+    if (actual.width != expected.width || actual.height != expected.height) {
+        box = Rect(0, 0, actual.width, actual.height);
+        return actual.width * actual.height;
+    }
+    int count = 0;
+    int left = actual.width, top = actual.height, right = -1, bottom = -1;
+    for (int y = 0; y < actual.height; ++y) {
+        for (int x = 0; x < actual.width; ++x) {
+            size_t i = (size_t)y * actual.width + x;
+            if (actual.pixels[i] == expected.pixels[i]) continue;
+            ++count;
+            left = std::min(left, x);
+            top = std::min(top, y);
+            right = std::max(right, x);
+            bottom = std::max(bottom, y);
+        }
+    }
+    box = count ? Rect(left, top, right - left + 1, bottom - top + 1) : Rect();
+    return count;
+}
+
+double paintMs(InWM::Window* window) {
+    auto start = std::chrono::steady_clock::now();
+    window->paint();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+// Builds the scene, paints it incrementally the way the event loop would,
+// then checks a full repaint gives the same frame. Returns false on
+// failure.
+bool runScene(const Scene& scene, const std::string& goldenDir, bool update, int repeat) {
+    // Bigger than every scene, so menus have to stop at the window's edge
+    auto app = Application::createHeadless(1024, 768);
+    auto window = app->createWindow(scene.name, scene.width, scene.height);
+    Rect all(0, 0, scene.width, scene.height);
+
+    scene.build(window.get());
+    window->show();
+    window->invalidate(all);
+    double firstMs = paintMs(window.get());
+
+    double updateMs = 0;
+    if (scene.interact) {
+        scene.interact(window.get());
+        updateMs = paintMs(window.get());
+    }
+    if (!window->getRaster()) {
+        printf("%-10s FAIL  nothing was rendered\n", scene.name);
+        return false;
+    }
+    Image frame = capture(*window->getRaster());
+
+    double totalMs = 0;
+    for (int i = 0; i < repeat; ++i) {
+        window->invalidate(all);
+        totalMs += paintMs(window.get());
+    }
+    Image repainted = capture(*window->getRaster());
+
+    std::string goldenPath = goldenDir + "/" + scene.name + ".ppm";
+    const char* status = "ok";
+    bool passed = true;
+    Rect box;
+    int differing = 0;
+    if (compare(frame, repainted, box) != 0) {
+        status = "FAIL  incremental paint differs from a full repaint";
+        passed = false;
+    } else if (update) {
+        if (writePPM(goldenPath, frame)) {
+            status = "updated";
+        } else {
+            status = "FAIL  could not write the golden image";
+            passed = false;
+        }
+    } else {
+        Image golden;
+        if (!readPPM(goldenPath, golden)) {
+            status = "FAIL  no golden image (run with --update)";
+            passed = false;
+        } else if ((differing = compare(frame, golden, box)) != 0) {
+            status = "FAIL";
+            passed = false;
+        }
+    }
+
+    printf("%-10s %3dx%-3d  first %7.3f ms  update %7.3f ms  repaint %7.3f ms  %s\n",
+           scene.name, scene.width, scene.height, firstMs, updateMs,
+           repeat ? totalMs / repeat : 0.0, status);
+    if (differing) {
+        std::string actualPath = std::string("test_render_") + scene.name + ".ppm";
+        writePPM(actualPath, frame);
+        printf("           %d pixels differ in %dx%d+%d+%d; frame written to %s\n", differing,
+               box.width, box.height, box.x, box.y, actualPath.c_str());
+    }
+    return passed;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string goldenDir = "golden";
+    bool update = false;
+    int repeat = 100;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--update") == 0) {
+            update = true;
+        } else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            goldenDir = argv[++i];
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(0, atoi(argv[++i]));
+        } else {
+            fprintf(stderr, "Usage: %s [--update] [--golden DIR] [--repeat N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int failures = 0;
+    for (const Scene& scene : SCENES) {
+        if (!runScene(scene, goldenDir, update, repeat)) ++failures;
+    }
+    if (failures) {
+        printf("%d of %zu scenes failed\n", failures, sizeof(SCENES) / sizeof(SCENES[0]));
+        return 1;
+    }
+    return 0;
+}
@@ -5,7 +5,7 @@
 #include "WindowManager.hpp"
 
 int main(int argc, char** argv) {
-  std::unique_ptr<WindowManager> wm(WindowManager::Create());
+  std::unique_ptr<WindowManager> wm(WindowManager::Create(argv));
   if (!wm) {
     printf("Unable to initialize window manager\n");
     return -1;
@@ -1,6 +1,7 @@
 #include "lib/Widgets.hpp"
 #include <ctime>
 #include <cstring>
+#include <cstdlib>
 #include <stdexcept>
 
 using namespace InWM;
@@ -10,57 +11,113 @@ class DesktopWidget : public Widget {
 public:
     DesktopWidget(Application* app, Widget* parent = nullptr) : Widget(app, parent) {}
     
-    void draw(Drawable drawable, GC gc) override {
-        if (!isVisible()) return;
-        
-        const Rect& bounds = getBounds();
+    ~DesktopWidget() {
+        Display* dpy = m_app->getDisplay();
+        if (m_tile != None) XFreePixmap(dpy, m_tile);
+        if (m_trashIcon.mask != None) XFreePixmap(dpy, m_trashIcon.mask);
+        if (m_hdIcon.mask != None) XFreePixmap(dpy, m_hdIcon.mask);
+    }
+    
+    // 8x8 tile holding one cell of the classic Mac OS desktop dot pattern.
+    // It is installed as the window background so the server repeats it.
+    Pixmap getPatternTile() {
+        if (m_tile != None) return m_tile;
         
-        // Fill with desktop gray
-        XSetForeground(m_app->getDisplay(), gc, 0xC0C0C0);
-        XFillRectangle(m_app->getDisplay(), drawable, gc, 
-                       bounds.x, bounds.y, bounds.width, bounds.height);
+        Display* dpy = m_app->getDisplay();
+        int screen = DefaultScreen(dpy);
+        m_tile = XCreatePixmap(dpy, m_app->getRoot(), TILE_SIZE, TILE_SIZE,
+                               DefaultDepth(dpy, screen));
         
-        // Draw classic Mac OS desktop dot pattern
-        XSetForeground(m_app->getDisplay(), gc, 0x808080); // Darker gray for dots
+        XFillRectangle(dpy, m_tile, GCCache::get(dpy, 0xC0C0C0), // Desktop gray
+                       0, 0, TILE_SIZE, TILE_SIZE);
+        XDrawPoint(dpy, m_tile, GCCache::get(dpy, 0x808080), // Darker gray for dots
+                   TILE_SIZE / 2, TILE_SIZE / 2);
         
-        // Draw dot pattern - dots every 8 pixels
-        for (int y = 4; y < bounds.height; y += 8) {
-            for (int x = 4; x < bounds.width; x += 8) {
-                XDrawPoint(m_app->getDisplay(), drawable, gc, x, y);
-            }
-        }
+        return m_tile;
+    }
+    
+    void draw(DrawContext& dc) override {
+        if (!isVisible()) return;
         
-        // Draw some desktop icons (simple representations)
-        drawDesktopIcons(drawable, gc);
+        // The dot pattern is the window background tile, so the server has
+        // already painted it. Only the icons are left for us, stamped with
+        // Xlib directly.
+        dc.flush();
+        if (dc.getDrawable() == None) return;
+        drawDesktopIcons(dc.getDrawable(), dc.getGC());
     }
     
 private:
+    // Icon shape cached in a 1-bit pixmap, stamped through the GC clip mask
+    struct DesktopIcon {
+        Pixmap mask = None;
+        int width = 0;
+        int height = 0;
+    };
+    
+    static const int TILE_SIZE = 8;
+    
     void drawDesktopIcons(Drawable drawable, GC gc) {
-        // Draw "Trash" icon in bottom-right corner
+        if (m_trashIcon.mask == None) createIcons();
+        
+        // "Trash" icon in bottom-right corner, "Hard Disk" in top-right corner
         int trashX = getBounds().width - 60;
         int trashY = getBounds().height - 80;
+        int hdX = getBounds().width - 60;
+        int hdY = 40;
         
-        // Trash can outline
         XSetForeground(m_app->getDisplay(), gc, 0x000000);
-        XDrawRectangle(m_app->getDisplay(), drawable, gc, trashX, trashY, 32, 40);
-        XDrawRectangle(m_app->getDisplay(), drawable, gc, trashX - 2, trashY - 5, 36, 5);
+        stampIcon(drawable, gc, m_trashIcon, trashX - 10, trashY - 10);
+        stampIcon(drawable, gc, m_hdIcon, hdX - 12, hdY - 2);
+        XSetClipMask(m_app->getDisplay(), gc, None);
+    }
+    
+    void stampIcon(Drawable drawable, GC gc, const DesktopIcon& icon, int x, int y) {
+        XSetClipMask(m_app->getDisplay(), gc, icon.mask);
+        XSetClipOrigin(m_app->getDisplay(), gc, x, y);
+        XFillRectangle(m_app->getDisplay(), drawable, gc, x, y, icon.width, icon.height);
+    }
+    
+    void createIcons() {
+        Display* dpy = m_app->getDisplay();
         
-        // Label
-        XDrawString(m_app->getDisplay(), drawable, gc, trashX - 5, trashY + 55, "Trash", 5);
+        // Trash can outline, lid and label
+        GC gc = beginIcon(m_trashIcon, 60, 72);
+        XDrawRectangle(dpy, m_trashIcon.mask, gc, 10, 10, 32, 40);
+        XDrawRectangle(dpy, m_trashIcon.mask, gc, 8, 5, 36, 5);
+        XDrawString(dpy, m_trashIcon.mask, gc, 5, 65, "Trash", 5);
+        XFreeGC(dpy, gc);
         
-        // Draw "HD" icon in top-right corner
-        int hdX = getBounds().width - 60;
-        int hdY = 40;
+        // Hard disk box and label
+        gc = beginIcon(m_hdIcon, 64, 56);
+        XDrawRectangle(dpy, m_hdIcon.mask, gc, 12, 2, 32, 32);
+        XDrawString(dpy, m_hdIcon.mask, gc, 20, 22, "HD", 2);
+        XDrawString(dpy, m_hdIcon.mask, gc, 2, 50, "Hard Disk", 9);
+        XFreeGC(dpy, gc);
+    }
+    
+    // Create a cleared bitmap for the icon and return a GC that draws into it
+    GC beginIcon(DesktopIcon& icon, int width, int height) {
+        Display* dpy = m_app->getDisplay();
+        icon.width = width;
+        icon.height = height;
+        icon.mask = XCreatePixmap(dpy, m_app->getRoot(), width, height, 1);
         
-        XDrawRectangle(m_app->getDisplay(), drawable, gc, hdX, hdY, 32, 32);
-        XDrawString(m_app->getDisplay(), drawable, gc, hdX + 8, hdY + 20, "HD", 2);
-        XDrawString(m_app->getDisplay(), drawable, gc, hdX - 10, hdY + 48, "Hard Disk", 9);
+        GC gc = XCreateGC(dpy, icon.mask, 0, nullptr);
+        XSetForeground(dpy, gc, 0);
+        XFillRectangle(dpy, icon.mask, gc, 0, 0, width, height);
+        XSetForeground(dpy, gc, 1);
+        return gc;
     }
+    
+    Pixmap m_tile = None;
+    DesktopIcon m_trashIcon;
+    DesktopIcon m_hdIcon;
 };
 
 class System8Bar {
   public:
-    System8Bar() {
+    System8Bar(const std::string& wallpaper = "") : m_wallpaper(wallpaper) {
         // Create application
         m_app = Application::create();
         if (!m_app) {
@@ -81,6 +138,11 @@ class System8Bar {
         XLowerWindow(m_app->getDisplay(), m_desktop->getXWindow());
         XRaiseWindow(m_app->getDisplay(), m_window->getXWindow());
         
+        // Decode the wallpaper in the background, the dot pattern shows until then
+        if (!m_wallpaper.empty()) {
+            Wallpaper::loadAsync(m_wallpaper, m_desktop->getXWindow());
+        }
+        
         printf("System 8 Desktop and Menu Bar started\n");
         m_app->run();
     }
@@ -102,6 +164,9 @@ private:
         m_desktopWidget = std::make_shared<DesktopWidget>(m_app.get(), m_desktop.get());
         m_desktopWidget->setBounds(Rect(0, 0, screenWidth, screenHeight));
         m_desktop->addChild(m_desktopWidget);
+        
+        // Let the server tile the dot pattern on every exposure
+        m_desktop->setBackgroundPixmap(m_desktopWidget->getPatternTile());
     }
     
     void createBarWindow() {
@@ -256,14 +321,23 @@ private:
     DropdownPtr m_viewMenu;
     DropdownPtr m_specialMenu;
     std::string m_timeString;
+    std::string m_wallpaper;
 };
 
-int main() {
+int main(int argc, char** argv) {
     printf("System 8 Menu Bar\n");
     printf("=================\n");
     
+    // Wallpaper image (PPM or QOI) from the command line or the environment
+    std::string wallpaper;
+    if (argc > 1) {
+        wallpaper = argv[1];
+    } else if (const char* env = getenv("INWM_WALLPAPER")) {
+        wallpaper = env;
+    }
+    
     try {
-        System8Bar bar;
+        System8Bar bar(wallpaper);
         bar.run();
     } catch (const std::exception& e) {
         printf("Error: %s\n", e.what());